@@ -0,0 +1,462 @@
+////////////////////////////////////////////////////////////////////////
+//
+// beat_engine.c
+//
+// The beat, independent of the windows.
+//
+// See beat_engine.h for more information.
+//
+
+#include "beat_engine.h"
+#include "timer_stack.h"
+#include "hw_timer.h"
+#include "event_storm.h"
+
+#include <string.h>
+
+static AppContextRef app_ctx;
+
+// What the beat timer is called in timer_stack's latency stats.
+static const char* const beat_source = event_storm_beat_name;
+
+static AppTimerHandle beat_timer;
+static bool running;
+
+// The beat grid.
+//
+// Beats are scheduled against an absolute grid in hw_timer ms rather
+// than by re-arming a relative timer from wherever the last one
+// happened to fire.  beat_time is the grid point of the current beat
+// and beat_frac holds the sub-ms remainder (Q8), so advancing by a
+// Q8 interval every beat never loses time.  Each slot of the groove
+// is then one table lookup away from the grid point.
+static uint32_t beat_time;
+static uint8_t beat_frac;
+static uint8_t beat_slot;
+
+// What's playing, and the table built from it.
+static uint8_t tempo;
+static groove_template groove;
+static groove_table groove_tab;
+
+// How the beat timer is armed against the grid, and how a late beat
+// is recovered from.  The animation has its own timer, so there are
+// no frames for it to multiplex.
+static beat_sched sched;
+
+static song_map song;
+
+static bool vibe_enabled;
+static vibe_synth vibes;
+
+static uint8_t stop_after;
+
+// Settings waiting for the next beat boundary.
+typedef struct {
+   uint8_t tempo;
+   groove_template groove;
+   bool timing;
+   bool vibe_enabled;
+   uint8_t vibe_ms;
+   bool vibe;
+   // The tempo and groove came from a song section.
+   bool section;
+} pending_settings;
+
+static pending_settings pending;
+
+typedef struct {
+   beat_engine_listener listener;
+   void* ctx;
+} subscriber;
+
+static subscriber subscribers[BEAT_ENGINE_MAX_LISTENERS];
+static uint8_t num_subscribers;
+
+static beat_engine_grid_hook grid_hook;
+
+static void notify( beat_engine_event event )
+{
+   beat_engine_info info = {
+      .event = event,
+      .time = beat_time,
+      .interval = groove_tab.interval_q8 >> 8,
+      .pos = song.pos
+   };
+
+   for( uint8_t i = 0; i < num_subscribers; i++ ) {
+      (*subscribers[i].listener)( &info, subscribers[i].ctx );
+   }
+}
+
+// groove_tab has changed.
+static void timing_changed( void )
+{
+   beat_sched_set_slot_ms( &sched,
+                           ( groove_tab.interval_q8 >> 8 )
+                              / groove_tab.num_slots );
+}
+
+static void apply_pending( void )
+{
+   if( pending.vibe ) {
+      vibe_enabled = pending.vibe_enabled;
+      vibe_synth_build( &vibes, pending.vibe_ms );
+      pending.vibe = false;
+   }
+   if( pending.timing ) {
+      tempo = pending.tempo;
+      groove = pending.groove;
+      groove_build( &groove_tab, &groove, tempo );
+      timing_changed();
+      pending.timing = false;
+   }
+   if( pending.section ) {
+      pending.section = false;
+      notify( BEAT_ENGINE_SECTION );
+   }
+}
+
+// Take the song's current section as the next tempo and groove.
+static void take_section( void )
+{
+   const library_section* sec = song_map_section( &song );
+
+   pending.tempo = sec->tempo;
+   song_map_section_groove( sec, &pending.groove );
+   pending.timing = true;
+   pending.section = true;
+   if( ! running ) {
+      apply_pending();
+   }
+}
+
+static uint32_t slot_time( uint8_t slot )
+{
+   return beat_time
+      + ( ( (int32_t) beat_frac + groove_tab.slot_offset_q8[slot] ) >> 8 );
+}
+
+static void arm_beat_timer( void )
+{
+   uint32_t delay = beat_sched_delay( &sched,
+                                      slot_time( beat_slot ),
+                                      hw_timer_get_time() );
+
+   beat_timer = timer_stack_send_event( app_ctx, delay, 0, beat_source );
+}
+
+// Whether the beat should stop rather than play the slot it's on.
+static bool beat_over( void )
+{
+   return    beat_slot == 0
+          && (    song.done
+               || ( stop_after > 0 && song.pos.beats >= stop_after ) );
+}
+
+// On to the next slot.  After the last one, step the grid point along
+// by exactly one beat; settings changes, and the song's next section,
+// take effect from there.
+static void next_slot( void )
+{
+   if( ++beat_slot < groove_tab.num_slots ) {
+      return;
+   }
+
+   uint32_t acc = beat_frac + groove_tab.interval_q8;
+   beat_time += acc >> 8;
+   beat_frac = acc & 0xFF;
+   beat_slot = 0;
+
+   if(    song_map_advance( &song, &groove, &groove_tab )
+       == SONG_MAP_NEW_SECTION ) {
+      // Its table was built ahead; just catch up with it.  It wins
+      // over a tempo or groove set in the meantime.
+      tempo = song_map_section( &song )->tempo;
+      timing_changed();
+      pending.tempo = tempo;
+      pending.groove = groove;
+      pending.timing = false;
+      pending.section = true;
+   }
+   apply_pending();
+
+   if( grid_hook ) {
+      (*grid_hook)( &beat_time, &beat_frac, groove_tab.interval_q8 );
+   }
+}
+
+static void beat( void )
+{
+   int32_t shift_ms = 0;
+   bool dropped = false;
+
+   // A beat that's come too late may be dropped, or move the grid.
+   // Dropped beats still count, so the bar keeps its place.
+   while(    ! beat_over()
+          && beat_sched_check( &sched,
+                               slot_time( beat_slot ),
+                               hw_timer_get_time(),
+                               &shift_ms )
+             == BEAT_SCHED_DROP ) {
+      next_slot();
+      dropped = true;
+   }
+   beat_time += shift_ms;
+
+   if( beat_over() ) {
+      beat_engine_stop();
+      return;
+   }
+   // Skipped ahead to a slot that's still to come.
+   if(    dropped
+       && (int32_t) ( slot_time( beat_slot ) - hw_timer_get_time() ) > 0 ) {
+      arm_beat_timer();
+      return;
+   }
+   beat_sched_played( &sched, hw_timer_get_time() );
+
+   if( beat_slot == 0 ) {
+      if( vibe_enabled ) {
+         vibes_enqueue_custom_pattern(
+            vibe_synth_pattern( &vibes, ( song.pos.beat == 0 )
+                                           ? VIBE_ACCENT_DOWNBEAT
+                                           : VIBE_ACCENT_BEAT ) );
+      }
+      notify( BEAT_ENGINE_BEAT );
+   } else if( vibe_enabled ) {
+      vibes_enqueue_custom_pattern(
+         vibe_synth_pattern( &vibes, VIBE_ACCENT_SUBDIVISION ) );
+   }
+
+   next_slot();
+   arm_beat_timer();
+   // With the timer armed, there's a beat's time to get the next
+   // section ready.
+   song_map_prefetch( &song );
+}
+
+// Start beating on the grid already set up in beat_time/beat_frac.
+static void start_grid( void )
+{
+   running = true;
+   beat_slot = 0;
+   beat_sched_start( &sched, hw_timer_get_time() );
+   notify( BEAT_ENGINE_STARTED );
+
+   if( (int32_t) ( slot_time( 0 ) - hw_timer_get_time() ) <= 0 ) {
+      beat();
+   } else {
+      arm_beat_timer();
+   }
+}
+
+static bool beat_engine_handle_timeout( AppContextRef ctx,
+                                        AppTimerHandle handle,
+                                        uint32_t cookie )
+{
+   if( handle != beat_timer || ! running ) {
+      return false;
+   }
+
+   if(    beat_sched_fired( &sched,
+                            slot_time( beat_slot ),
+                            hw_timer_get_time() )
+       == BEAT_SCHED_BEAT ) {
+      beat();
+   } else {
+      arm_beat_timer();
+   }
+   return true;
+}
+
+void beat_engine_init_once( AppContextRef ctx,
+                            const vibe_accent_shape* shapes )
+{
+   app_ctx = ctx;
+   running = false;
+   num_subscribers = 0;
+   grid_hook = NULL;
+   stop_after = 0;
+
+   memset( &pending, 0, sizeof(pending) );
+   pending.tempo = 120;
+   groove_template_init( &pending.groove );
+   pending.timing = true;
+   pending.vibe_enabled = true;
+   pending.vibe_ms = 50;
+   pending.vibe = true;
+
+   vibe_synth_init( &vibes, shapes );
+   beat_sched_init( &sched, BEAT_SCHED_ABSOLUTE, 0 );
+   beat_sched_set_recovery( &sched, BEAT_SCHED_SKIP );
+   song_map_init( &song );
+   apply_pending();
+
+   timer_stack_push( &beat_engine_handle_timeout );
+}
+
+bool beat_engine_subscribe( beat_engine_listener listener, void* ctx )
+{
+   if( num_subscribers == BEAT_ENGINE_MAX_LISTENERS ) {
+      return false;
+   }
+   subscribers[num_subscribers].listener = listener;
+   subscribers[num_subscribers].ctx = ctx;
+   num_subscribers++;
+   return true;
+}
+
+void beat_engine_set_grid_hook( beat_engine_grid_hook hook )
+{
+   grid_hook = hook;
+}
+
+void beat_engine_set_tempo( uint8_t new_tempo )
+{
+   pending.tempo = new_tempo;
+   pending.timing = true;
+   if( ! running ) {
+      apply_pending();
+   }
+}
+
+void beat_engine_set_groove( const groove_template* new_groove )
+{
+   pending.groove = *new_groove;
+   pending.timing = true;
+   if( ! running ) {
+      apply_pending();
+   }
+}
+
+void beat_engine_set_vibe( bool enabled, uint8_t length_ms )
+{
+   pending.vibe_enabled = enabled;
+   pending.vibe_ms = length_ms;
+   pending.vibe = true;
+   if( ! running ) {
+      apply_pending();
+   }
+}
+
+void beat_engine_set_stop_after( uint8_t beats )
+{
+   // Only looked at on the beat boundary anyway.
+   stop_after = beats;
+}
+
+void beat_engine_set_recovery( beat_sched_recovery recovery )
+{
+   beat_sched_set_recovery( &sched, recovery );
+}
+
+bool beat_engine_load_song( uint16_t index )
+{
+   if( ! song_map_load_song( &song, index ) ) {
+      return false;
+   }
+   take_section();
+   return true;
+}
+
+void beat_engine_load_section( const library_section* sec )
+{
+   song_map_load_section( &song, sec );
+   take_section();
+}
+
+void beat_engine_start( void )
+{
+   apply_pending();
+   beat_time = hw_timer_get_time();
+   beat_frac = 0;
+
+   // A pushed downbeat can't sound before the start, so the grid is
+   // started late enough for it to land right now.
+   if( groove_tab.slot_offset_q8[0] < 0 ) {
+      beat_time += ( - groove_tab.slot_offset_q8[0] ) >> 8;
+   }
+
+   if( ! running ) {
+      start_grid();
+   }
+}
+
+void beat_engine_start_at( uint32_t time, uint8_t frac )
+{
+   apply_pending();
+   beat_time = time;
+   beat_frac = frac;
+
+   if( running ) {
+      timer_stack_cancel_event( app_ctx, beat_timer );
+      beat_slot = 0;
+      beat_sched_start( &sched, hw_timer_get_time() );
+      arm_beat_timer();
+   } else {
+      start_grid();
+   }
+}
+
+void beat_engine_stop( void )
+{
+   if( ! running ) {
+      return;
+   }
+   running = false;
+   timer_stack_cancel_event( app_ctx, beat_timer );
+   notify( BEAT_ENGINE_STOPPED );
+
+   // Next time, from the top of the song, as written - tempo and
+   // groove changes made while it played are dropped, whichever
+   // section they were made in.
+   if( song_map_rewind( &song ) ) {
+      take_section();
+   } else {
+      apply_pending();
+   }
+}
+
+void beat_engine_cancel( void )
+{
+   bool moved = ( song.pos.section > 0 );
+
+   if( ! running ) {
+      return;
+   }
+   running = false;
+   timer_stack_cancel_event( app_ctx, beat_timer );
+   notify( BEAT_ENGINE_STOPPED );
+
+   if( song_map_rewind( &song ) && moved ) {
+      take_section();
+   } else {
+      apply_pending();
+   }
+}
+
+bool beat_engine_running( void )
+{
+   return running;
+}
+
+uint8_t beat_engine_tempo( void )
+{
+   return tempo;
+}
+
+const groove_template* beat_engine_groove( void )
+{
+   return &groove;
+}
+
+beat_sched_recovery beat_engine_recovery( void )
+{
+   return sched.recovery;
+}
+
+const beat_sched_stats* beat_engine_stats( void )
+{
+   return &sched.stats;
+}
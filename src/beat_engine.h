@@ -0,0 +1,122 @@
+#ifndef BEAT_ENGINE_H
+#define BEAT_ENGINE_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "groove.h"
+#include "beat_sched.h"
+#include "song_map.h"
+#include "vibe_synth.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// beat_engine.h
+//
+// The beat itself - the grid, its timer, the song and the vibes - as a
+// service that runs whatever window is on top.
+//
+// Its timeout handler goes on the bottom of the timer stack when it's
+// initialized and stays there, so the beat carries on through menus
+// and editors.  Windows don't drive it; they change its settings and
+// listen to it.
+//
+// Settings changed while the beat runs - tempo, groove, vibration -
+// wait for the next beat boundary, so a beat is never played half in
+// one setting and half in another.  While stopped they apply at once.
+//
+// Listeners hear when the beat starts and stops, when each beat
+// sounds, and when a song section changes the tempo and groove.
+// They're called from the beat itself, so they should do no more than
+// mark layers dirty and arm timers.
+//
+// To use this:
+//
+// 1.  Call beat_engine_init_once() in your app init function, after
+//     timer_stack_init_once(), then set the tempo and anything else
+//     you want other than the defaults.
+//
+// 2.  Subscribe whatever draws the beat.
+//
+// 3.  beat_engine_start() and beat_engine_stop() it.
+
+typedef enum {
+   BEAT_ENGINE_STARTED = 0,
+   BEAT_ENGINE_BEAT,
+   BEAT_ENGINE_SECTION,
+   BEAT_ENGINE_STOPPED
+} beat_engine_event;
+
+typedef struct {
+   beat_engine_event event;
+   // BEAT: the beat's grid point and length, ms, and where it is in
+   // the song.
+   uint32_t time;
+   uint32_t interval;
+   song_pos pos;
+} beat_engine_info;
+
+typedef void (* beat_engine_listener)( const beat_engine_info* info,
+                                       void* ctx );
+
+// Called each time the grid point steps on to the next beat, with the
+// length of the beat, so the grid can be pulled elsewhere (see the
+// ensemble in metronome.c).
+typedef void (* beat_engine_grid_hook)( uint32_t* beat_time,
+                                        uint8_t* beat_frac,
+                                        uint32_t interval_q8 );
+
+#define BEAT_ENGINE_MAX_LISTENERS (4)
+
+void beat_engine_init_once( AppContextRef ctx,
+                            const vibe_accent_shape* shapes );
+
+// Returns false if there's no room for another listener.
+bool beat_engine_subscribe( beat_engine_listener listener, void* ctx );
+
+void beat_engine_set_grid_hook( beat_engine_grid_hook hook );
+
+void beat_engine_set_tempo( uint8_t tempo );
+
+void beat_engine_set_groove( const groove_template* groove );
+
+void beat_engine_set_vibe( bool enabled, uint8_t length_ms );
+
+// 0 never stops.
+void beat_engine_set_stop_after( uint8_t beats );
+
+void beat_engine_set_recovery( beat_sched_recovery recovery );
+
+// Play a library song, or a single section, from the top.  Its tempo
+// and groove arrive like any other setting, announced with
+// BEAT_ENGINE_SECTION.  Returns false if the song can't be read.
+bool beat_engine_load_song( uint16_t song );
+
+void beat_engine_load_section( const library_section* sec );
+
+// Start with a beat right now.
+void beat_engine_start( void );
+
+// Start with a beat at time (hw_timer ms), plus frac/256 ms; or if
+// already running, move the beat there.  Settings waiting for a
+// boundary are applied first.
+void beat_engine_start_at( uint32_t time, uint8_t frac );
+
+void beat_engine_stop( void );
+
+// Take back a start made moments ago: stop, and go back to the top of
+// the song, but keep the tempo and groove it had before starting
+// rather than taking the song's first section again.  Only if the
+// start has already crossed into another section is that re-taken.
+void beat_engine_cancel( void );
+
+bool beat_engine_running( void );
+
+// What's being played, or will be on starting.
+uint8_t beat_engine_tempo( void );
+const groove_template* beat_engine_groove( void );
+
+beat_sched_recovery beat_engine_recovery( void );
+
+const beat_sched_stats* beat_engine_stats( void );
+
+#endif
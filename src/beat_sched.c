@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////
+//
+// beat_sched.c
+//
+// Beat timer arming policies.
+//
+// See beat_sched.h for more information.
+//
+
+#include "beat_sched.h"
+
+#include <string.h>
+
+const char* const beat_sched_policy_names[BEAT_SCHED_NUM_POLICIES] = {
+   "relative",
+   "absolute",
+   "early",
+   "multiplex"
+};
+
+const char* const beat_sched_recovery_names[BEAT_SCHED_NUM_RECOVERIES] = {
+   "Skip",
+   "Catch Up",
+   "Shift"
+};
+
+// EARLY's estimate moves 1/LATE_WEIGHT of the way to each new
+// lateness.
+#define LATE_WEIGHT (8)
+
+// EARLY ignores fires this late when learning - they're a stall, not
+// the OS's usual habit.
+#define LATE_OUTLIER_MS (40)
+
+void beat_sched_init( beat_sched* sched,
+                      beat_sched_policy policy,
+                      uint16_t frame_ms )
+{
+   memset( sched, 0, sizeof(*sched) );
+   sched->policy = policy;
+   sched->frame_ms = frame_ms;
+}
+
+void beat_sched_start( beat_sched* sched, uint32_t now )
+{
+   sched->started = false;
+   sched->expected = now;
+   sched->compensate = true;
+   sched->frame_time = now + sched->frame_ms;
+   sched->catching_up = false;
+}
+
+void beat_sched_set_recovery( beat_sched* sched,
+                              beat_sched_recovery recovery )
+{
+   sched->recovery = recovery;
+   sched->catching_up = false;
+}
+
+void beat_sched_set_slot_ms( beat_sched* sched, uint16_t slot_ms )
+{
+   sched->slot_ms = slot_ms;
+}
+
+static uint32_t until( uint32_t when, uint32_t now )
+{
+   int32_t delay = (int32_t) ( when - now );
+
+   return ( delay < 0 ) ? 0 : delay;
+}
+
+uint32_t beat_sched_delay( beat_sched* sched,
+                           uint32_t deadline,
+                           uint32_t now )
+{
+   uint32_t delay;
+
+   // Catching up, a beat comes no sooner than a shortened slot after
+   // the last one.
+   if( sched->catching_up ) {
+      uint32_t earliest = sched->last_played
+         + sched->slot_ms * BEAT_SCHED_CATCH_UP_PCT / 100;
+
+      if( (int32_t) ( earliest - deadline ) > 0 ) {
+         deadline = earliest;
+      }
+   }
+
+   switch( sched->policy ) {
+   case BEAT_SCHED_RELATIVE:
+      delay = sched->started ? deadline - sched->last_deadline
+                             : until( deadline, now );
+      sched->last_deadline = deadline;
+      sched->started = true;
+      sched->expected = now + delay;
+      return delay;
+
+   case BEAT_SCHED_EARLY:
+      delay = until( deadline, now );
+      if( sched->compensate && sched->late_q4 > 0 ) {
+         uint32_t early = sched->late_q4 >> 4;
+         delay = ( delay > early ) ? delay - early : 0;
+      }
+      sched->expected = now + delay;
+      return delay;
+
+   case BEAT_SCHED_MULTIPLEX:
+      if(    sched->frame_ms > 0
+          && (int32_t) ( sched->frame_time - deadline ) < 0 ) {
+         return until( sched->frame_time, now );
+      }
+      return until( deadline, now );
+
+   case BEAT_SCHED_ABSOLUTE:
+   default:
+      return until( deadline, now );
+   }
+}
+
+beat_sched_action beat_sched_fired( beat_sched* sched,
+                                    uint32_t deadline,
+                                    uint32_t now )
+{
+   int32_t early = (int32_t) ( deadline - now );
+
+   switch( sched->policy ) {
+   case BEAT_SCHED_EARLY:
+      if( sched->compensate ) {
+         int32_t late = (int32_t) ( now - sched->expected );
+
+         if( late < LATE_OUTLIER_MS ) {
+            sched->late_q4 += ( late * 16 - sched->late_q4 )
+                              / LATE_WEIGHT;
+         }
+      }
+      // Too early: wait out the rest, uncompensated, so it can't come
+      // back early again.
+      sched->compensate = ( early <= BEAT_SCHED_EARLY_SLACK_MS );
+      return sched->compensate ? BEAT_SCHED_BEAT : BEAT_SCHED_WAIT;
+
+   case BEAT_SCHED_MULTIPLEX:
+      if( sched->frame_ms == 0 || early <= 0 ) {
+         // The frames restart from the beat.
+         sched->frame_time = deadline + sched->frame_ms;
+         return BEAT_SCHED_BEAT;
+      }
+      do {
+         sched->frame_time += sched->frame_ms;
+      } while( (int32_t) ( sched->frame_time - now ) <= 0 );
+      // A frame just short of the beat would be drawn twice over;
+      // leave it to the beat.
+      if( (int32_t) ( deadline - sched->frame_time ) < sched->frame_ms / 2 ) {
+         sched->frame_time = deadline;
+      }
+      return BEAT_SCHED_FRAME;
+
+   default:
+      return BEAT_SCHED_BEAT;
+   }
+}
+
+beat_sched_verdict beat_sched_check( beat_sched* sched,
+                                     uint32_t deadline,
+                                     uint32_t now,
+                                     int32_t* shift_ms )
+{
+   int32_t late = (int32_t) ( now - deadline );
+
+   *shift_ms = 0;
+
+   // Late against the timer, not the grid it has drifted from.
+   if( sched->policy == BEAT_SCHED_RELATIVE ) {
+      late = (int32_t) ( now - sched->expected );
+   }
+
+   // Close enough to the grid - caught up, if catching up.
+   if( late < BEAT_SCHED_MISS_MS ) {
+      sched->catching_up = false;
+      return BEAT_SCHED_PLAY;
+   }
+
+   // Still working off an earlier miss.
+   if( sched->catching_up ) {
+      return BEAT_SCHED_PLAY;
+   }
+
+   sched->stats.misses++;
+   if( late > sched->stats.max_late_ms ) {
+      sched->stats.max_late_ms = ( late > UINT16_MAX ) ? UINT16_MAX : late;
+   }
+
+   if( sched->policy == BEAT_SCHED_RELATIVE ) {
+      return BEAT_SCHED_PLAY;
+   }
+
+   switch( sched->recovery ) {
+   case BEAT_SCHED_SKIP:
+      sched->stats.dropped++;
+      return BEAT_SCHED_DROP;
+
+   case BEAT_SCHED_CATCH_UP:
+      sched->catching_up = true;
+      break;
+
+   case BEAT_SCHED_SHIFT:
+   default:
+      *shift_ms = late;
+      sched->stats.shifted_ms += late;
+      break;
+   }
+
+   return BEAT_SCHED_PLAY;
+}
+
+void beat_sched_played( beat_sched* sched, uint32_t now )
+{
+   sched->last_played = now;
+}
@@ -0,0 +1,170 @@
+#ifndef BEAT_SCHED_H
+#define BEAT_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// beat_sched.h
+//
+// How the beat timer is armed, given when the beat is due on the
+// grid.  The watch uses one policy; tools/trace_replay.c runs them
+// all against the same recorded timer behaviour to compare them.
+//
+// RELATIVE    Re-arm for one interval from wherever the last timer
+//             fired.  Every late fire is carried forward, so the beat
+//             drifts.
+//
+// ABSOLUTE    Arm for the grid point.  A late fire costs that beat,
+//             not the rest.
+//
+// EARLY       ABSOLUTE, asking for the timer early by a running
+//             estimate of how late timers fire.  A timer that comes
+//             back too early is armed again for the rest.
+//
+// MULTIPLEX   The beat and the animation frames share one timer.  A
+//             beat is also a frame, and the frames restart from it,
+//             so a beat costs no wakeup of its own.
+//
+// Whatever the policy, the OS sometimes doesn't fire the timer until
+// long after the beat was due - a notification, a Bluetooth burst.  A
+// beat BEAT_SCHED_MISS_MS or more late is a miss, and is recovered
+// from in one of three ways:
+//
+// SKIP        Drop the missed beats and carry on from the next grid
+//             point still to come.  The bar keeps its place.
+//
+// CATCH_UP    Play the missed beat now, and the ones after it at
+//             BEAT_SCHED_CATCH_UP_PCT of their usual spacing until
+//             they're back on the grid.
+//
+// SHIFT       Play the missed beat now and move the grid along by
+//             however late it was.
+//
+// RELATIVE has no grid to keep to - it carries every late fire forward
+// anyway - so it's only ever late against the timer it armed, and
+// its misses are counted but never recovered from.
+//
+// To use this:
+//
+// 1.  Call beat_sched_init(), then beat_sched_start() when the grid
+//     starts.  Tell it the spacing of the slots with
+//     beat_sched_set_slot_ms() whenever that changes.
+//
+// 2.  Arm the timer for beat_sched_delay().  When it fires, do what
+//     beat_sched_fired() says: play the beat, draw a frame, or
+//     neither.  Then arm it again.
+//
+// 3.  Before playing a beat, ask beat_sched_check() whether to drop it
+//     or shift the grid.  Call beat_sched_played() when one is
+//     played.
+
+typedef enum {
+   BEAT_SCHED_RELATIVE = 0,
+   BEAT_SCHED_ABSOLUTE,
+   BEAT_SCHED_EARLY,
+   BEAT_SCHED_MULTIPLEX,
+   BEAT_SCHED_NUM_POLICIES
+} beat_sched_policy;
+
+extern const char* const beat_sched_policy_names[BEAT_SCHED_NUM_POLICIES];
+
+typedef enum {
+   BEAT_SCHED_BEAT = 0,
+   BEAT_SCHED_FRAME,
+   BEAT_SCHED_WAIT
+} beat_sched_action;
+
+typedef enum {
+   BEAT_SCHED_SKIP = 0,
+   BEAT_SCHED_CATCH_UP,
+   BEAT_SCHED_SHIFT,
+   BEAT_SCHED_NUM_RECOVERIES
+} beat_sched_recovery;
+
+extern const char* const
+beat_sched_recovery_names[BEAT_SCHED_NUM_RECOVERIES];
+
+typedef enum {
+   BEAT_SCHED_PLAY = 0,
+   BEAT_SCHED_DROP
+} beat_sched_verdict;
+
+// EARLY plays a beat this close to its grid point rather than arming
+// again.
+#define BEAT_SCHED_EARLY_SLACK_MS (2)
+
+// Late enough to be heard as a stumble.
+#define BEAT_SCHED_MISS_MS (25)
+
+#define BEAT_SCHED_CATCH_UP_PCT (50)
+
+typedef struct {
+   // Beats that were BEAT_SCHED_MISS_MS or more late.
+   uint32_t misses;
+   // Of those, dropped by SKIP.
+   uint32_t dropped;
+   // How far SHIFT has moved the grid, all told.
+   uint32_t shifted_ms;
+   uint16_t max_late_ms;
+} beat_sched_stats;
+
+typedef struct {
+   beat_sched_policy policy;
+   bool started;
+   // RELATIVE: the grid point the last timer was armed for.
+   uint32_t last_deadline;
+   // RELATIVE and EARLY: when the armed timer should fire.  EARLY: how
+   // late timers have been firing (ms, Q4), and whether this arming
+   // is compensated.
+   uint32_t expected;
+   int16_t late_q4;
+   bool compensate;
+   // MULTIPLEX: frame period, 0 if not animating, and the next frame.
+   uint16_t frame_ms;
+   uint32_t frame_time;
+
+   beat_sched_recovery recovery;
+   uint16_t slot_ms;
+   uint32_t last_played;
+   bool catching_up;
+   beat_sched_stats stats;
+} beat_sched;
+
+void beat_sched_init( beat_sched* sched,
+                      beat_sched_policy policy,
+                      uint16_t frame_ms );
+
+void beat_sched_start( beat_sched* sched, uint32_t now );
+
+void beat_sched_set_recovery( beat_sched* sched,
+                              beat_sched_recovery recovery );
+
+// The usual spacing between slots, for CATCH_UP.
+void beat_sched_set_slot_ms( beat_sched* sched, uint16_t slot_ms );
+
+// Timeout to ask for, the next beat being due at deadline.
+uint32_t beat_sched_delay( beat_sched* sched,
+                           uint32_t deadline,
+                           uint32_t now );
+
+// The timer fired at now.
+beat_sched_action beat_sched_fired( beat_sched* sched,
+                                    uint32_t deadline,
+                                    uint32_t now );
+
+// The beat due at deadline is about to be played at now.  On DROP,
+// move on to the next slot without playing this one and check that.
+// On PLAY, move the grid later by *shift_ms first.  After a DROP, the
+// slot it says to play may still be to come: arm the timer for it
+// instead.
+beat_sched_verdict beat_sched_check( beat_sched* sched,
+                                     uint32_t deadline,
+                                     uint32_t now,
+                                     int32_t* shift_ms );
+
+// A beat was played at now.
+void beat_sched_played( beat_sched* sched, uint32_t now );
+
+#endif
@@ -0,0 +1,160 @@
+////////////////////////////////////////////////////////////////////////
+//
+// big_digits.c
+//
+// Pre-rendered glyph atlas and per-digit dirty tracking for large
+// numbers.
+//
+// See big_digits.h for more information.
+//
+
+#include "big_digits.h"
+
+#define BIG_DIGIT_MINUS (10)
+#define BIG_DIGIT_BLANK (0xFF)
+
+// Segment stroke, px.
+#define STROKE (5)
+
+// The atlas: the ten digits and the minus sign side by side, 1 bit
+// per pixel, rows padded to a multiple of 4 bytes as GBitmap requires.
+#define NUM_GLYPHS (11)
+#define ATLAS_WIDTH ( NUM_GLYPHS * BIG_DIGIT_WIDTH )
+#define ATLAS_ROW_BYTES ( ( ( ATLAS_WIDTH + 31 ) / 32 ) * 4 )
+
+static uint8_t atlas_bits[ATLAS_ROW_BYTES * BIG_DIGIT_HEIGHT];
+
+// One view onto the atlas per glyph.
+static GBitmap glyphs[NUM_GLYPHS];
+
+// Segments a-g, as rectangles within a cell.
+static const GRect segments[7] = {
+   // a - top
+   { { 0, 0 }, { BIG_DIGIT_WIDTH, STROKE } },
+   // b - upper right
+   { { BIG_DIGIT_WIDTH - STROKE, 0 }, { STROKE, BIG_DIGIT_HEIGHT / 2 } },
+   // c - lower right
+   { { BIG_DIGIT_WIDTH - STROKE, BIG_DIGIT_HEIGHT / 2 },
+     { STROKE, BIG_DIGIT_HEIGHT / 2 } },
+   // d - bottom
+   { { 0, BIG_DIGIT_HEIGHT - STROKE }, { BIG_DIGIT_WIDTH, STROKE } },
+   // e - lower left
+   { { 0, BIG_DIGIT_HEIGHT / 2 }, { STROKE, BIG_DIGIT_HEIGHT / 2 } },
+   // f - upper left
+   { { 0, 0 }, { STROKE, BIG_DIGIT_HEIGHT / 2 } },
+   // g - middle
+   { { 0, ( BIG_DIGIT_HEIGHT - STROKE ) / 2 }, { BIG_DIGIT_WIDTH, STROKE } },
+};
+
+// Which segments make up each glyph; bit 0 is segment a.
+static const uint8_t glyph_segments[NUM_GLYPHS] = {
+   0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F,
+   0x40  // minus
+};
+
+static void atlas_fill( int16_t x0, GRect r )
+{
+   for( int16_t y = r.origin.y; y < r.origin.y + r.size.h; y++ ) {
+      uint8_t* row = &atlas_bits[y * ATLAS_ROW_BYTES];
+      for( int16_t x = x0 + r.origin.x;
+           x < x0 + r.origin.x + r.size.w;
+           x++ ) {
+         // Bits are white; clearing one paints it black.
+         row[x >> 3] &= ~( 1 << ( x & 7 ) );
+      }
+   }
+}
+
+void big_digits_init_once( void )
+{
+   memset( atlas_bits, 0xFF, sizeof(atlas_bits) );
+
+   for( int d = 0; d < NUM_GLYPHS; d++ ) {
+      int16_t x0 = d * BIG_DIGIT_WIDTH;
+
+      for( int s = 0; s < 7; s++ ) {
+         if( glyph_segments[d] & ( 1 << s ) ) {
+            atlas_fill( x0, segments[s] );
+         }
+      }
+
+      glyphs[d].addr = atlas_bits;
+      glyphs[d].row_size_bytes = ATLAS_ROW_BYTES;
+      glyphs[d].info_flags = 0;
+      glyphs[d].bounds = GRect( x0, 0, BIG_DIGIT_WIDTH, BIG_DIGIT_HEIGHT );
+   }
+}
+
+static void draw_cell( Layer* lay, GContext* ctx )
+{
+   big_digit_cell* cell = (big_digit_cell*) lay;
+   GRect box = GRect( 0, 0, BIG_DIGIT_WIDTH, BIG_DIGIT_HEIGHT );
+
+   if( cell->glyph == BIG_DIGIT_BLANK ) {
+      graphics_context_set_fill_color( ctx, GColorWhite );
+      graphics_fill_rect( ctx, box, 0, GCornerNone );
+   } else {
+      graphics_context_set_compositing_mode( ctx, GCompOpAssign );
+      graphics_draw_bitmap_in_rect( ctx, &glyphs[cell->glyph], box );
+   }
+}
+
+static void set_cell( big_digit_cell* cell, uint8_t glyph )
+{
+   if( cell->glyph != glyph ) {
+      cell->glyph = glyph;
+      layer_mark_dirty( &cell->layer );
+   }
+}
+
+void big_digits_init( big_digits* digits,
+                      Layer* parent,
+                      GPoint origin,
+                      uint8_t num_digits )
+{
+   if( num_digits > BIG_DIGITS_MAX_DIGITS ) {
+      num_digits = BIG_DIGITS_MAX_DIGITS;
+   }
+   digits->num_digits = num_digits;
+
+   layer_init( &digits->layer,
+               GRect( origin.x, origin.y,
+                      BIG_DIGITS_WIDTH(num_digits), BIG_DIGIT_HEIGHT ) );
+   layer_add_child( parent, &digits->layer );
+
+   for( int c = 0; c < num_digits; c++ ) {
+      big_digit_cell* cell = &digits->cells[c];
+      layer_init( &cell->layer,
+                  GRect( c * ( BIG_DIGIT_WIDTH + BIG_DIGIT_GAP ), 0,
+                         BIG_DIGIT_WIDTH, BIG_DIGIT_HEIGHT ) );
+      cell->layer.update_proc = (LayerUpdateProc) &draw_cell;
+      cell->glyph = BIG_DIGIT_BLANK;
+      layer_add_child( &digits->layer, &cell->layer );
+   }
+}
+
+void big_digits_set_value( big_digits* digits, int value )
+{
+   bool negative = ( value < 0 );
+   unsigned int mag = negative ? -value : value;
+
+   // Fill from the right; leading zeros are blank, but a value of 0
+   // still shows one digit.  The minus sign goes in the first blank.
+   for( int c = digits->num_digits - 1; c >= 0; c-- ) {
+      if( mag == 0 && c != digits->num_digits - 1 ) {
+         set_cell( &digits->cells[c],
+                   negative ? BIG_DIGIT_MINUS : BIG_DIGIT_BLANK );
+         negative = false;
+      } else {
+         set_cell( &digits->cells[c], mag % 10 );
+      }
+      mag /= 10;
+   }
+}
+
+void big_digits_set_blank( big_digits* digits )
+{
+   for( int c = 0; c < digits->num_digits; c++ ) {
+      set_cell( &digits->cells[c], BIG_DIGIT_BLANK );
+   }
+}
@@ -0,0 +1,69 @@
+#ifndef BIG_DIGITS_H
+#define BIG_DIGITS_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// big_digits.h
+//
+// Large, fixed-width numbers drawn from a pre-rendered glyph atlas.
+//
+// Laying out a number in a proportional system font on every change
+// is slow, and without font metrics its width can only be found by
+// trial and error.  Here, the ten digits and a minus sign are
+// rendered once at startup into a single 1-bit bitmap atlas.  Drawing
+// a digit is then a blit of one fixed-size cell out of the atlas, and
+// a number is always exactly num_digits cells wide, right-aligned, so
+// layout is deterministic.
+//
+// Each digit is its own small layer, and changing the value only
+// marks the cells whose digit actually changed as dirty.  Spinning a
+// value from 119 to 120 redraws two cells; from 120 to 121, one.
+//
+// To use this:
+//
+// 1.  Call big_digits_init_once() in your app init function.
+//
+// 2.  Call big_digits_init() to add a number to a window, and
+//     big_digits_set_value() whenever the value changes.
+
+#define BIG_DIGIT_WIDTH (24)  // px
+#define BIG_DIGIT_HEIGHT (40) // px
+#define BIG_DIGIT_GAP (4)     // px between cells
+
+#define BIG_DIGITS_MAX_DIGITS (3)
+
+// Width of a number of num_digits cells.
+#define BIG_DIGITS_WIDTH(num_digits) \
+   ( (num_digits) * ( BIG_DIGIT_WIDTH + BIG_DIGIT_GAP ) - BIG_DIGIT_GAP )
+
+typedef struct {
+   // Must be first - the update proc gets handed this.
+   Layer layer;
+   // Atlas index, or BIG_DIGIT_BLANK.
+   uint8_t glyph;
+} big_digit_cell;
+
+typedef struct {
+   Layer layer;
+   uint8_t num_digits;
+   big_digit_cell cells[BIG_DIGITS_MAX_DIGITS];
+} big_digits;
+
+void big_digits_init_once( void );
+
+void big_digits_init( big_digits* digits,
+                      Layer* parent,
+                      GPoint origin,
+                      uint8_t num_digits );
+
+// Negative values get a minus sign in the cell before the first
+// digit.
+void big_digits_set_value( big_digits* digits, int value );
+
+// Show nothing at all.
+void big_digits_set_blank( big_digits* digits );
+
+#endif
@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////
+//
+// clock_sync.c
+//
+// NTP-style offset and skew estimation against a reference clock.
+//
+// See clock_sync.h for more information.
+//
+
+#include "clock_sync.h"
+
+#include <string.h>
+
+#define REQUEST_LEN (6)
+#define RESPONSE_LEN (14)
+#define EPOCH_LEN (6)
+
+// Samples whose delay is within this of the best one are always good
+// enough to fit the skew to.  On a jittery link, so is the faster half.
+#define SKEW_DELAY_SLACK_MS (4)
+
+// Every this many ms of age counts as a ms of delay when picking the
+// best sample.  That's steep - far more than any skew error costs - so
+// in practice the fastest of the last few samples wins.  Trusting
+// older, faster samples for longer was tried in tools/sync_sim.c and
+// is worse: with polls up to CLOCK_SYNC_MAX_POLL_MS apart, a noisy
+// skew carries them further off than their round trip saves.
+#define SAMPLE_AGE_DIVISOR (32)
+
+// The skew isn't fitted until the good samples span this long - any
+// shorter and a few ms of noise is a few hundred ppm of slope.
+#define SKEW_MIN_SPAN_MS (60000)
+
+static uint32_t get_u32( const uint8_t* p )
+{
+   return p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (uint32_t) p[3] << 24 );
+}
+
+static void put_u32( uint8_t* p, uint32_t v )
+{
+   p[0] = v & 0xFF;
+   p[1] = ( v >> 8 ) & 0xFF;
+   p[2] = ( v >> 16 ) & 0xFF;
+   p[3] = v >> 24;
+}
+
+void clock_sync_init( clock_sync* cs )
+{
+   memset( cs, 0, sizeof(*cs) );
+   cs->poll_interval = CLOCK_SYNC_MIN_POLL_MS;
+}
+
+bool clock_sync_is_synced( const clock_sync* cs )
+{
+   return cs->num_samples >= CLOCK_SYNC_ACQUIRE;
+}
+
+static uint8_t make_request( clock_sync* cs, uint32_t now, uint8_t* msg )
+{
+   cs->request_id++;
+   cs->outstanding = true;
+   cs->last_poll = now;
+   cs->stats.requests++;
+
+   msg[0] = CLOCK_SYNC_MSG_REQUEST;
+   msg[1] = cs->request_id;
+   put_u32( &msg[2], now );
+   return REQUEST_LEN;
+}
+
+uint8_t clock_sync_poll( clock_sync* cs, uint32_t now, uint8_t* msg )
+{
+   uint32_t since = now - cs->last_poll;
+
+   if( cs->outstanding ) {
+      if( since < CLOCK_SYNC_TIMEOUT_MS ) {
+         return 0;
+      }
+      cs->outstanding = false;
+      cs->stats.lost++;
+   }
+
+   // Until synced there's no point waiting between tries.
+   if(    clock_sync_is_synced( cs )
+       && cs->stats.requests > 0
+       && since < cs->poll_interval ) {
+      return 0;
+   }
+
+   return make_request( cs, now, msg );
+}
+
+// Offset predicted by the current estimate at local time t.
+static uint32_t predicted_offset( const clock_sync* cs, uint32_t t )
+{
+   int32_t dt = (int32_t) ( t - cs->ref_local );
+   return cs->offset + (int32_t) ( (int64_t) cs->skew_ppm * dt / 1000000 );
+}
+
+static uint16_t min_delay( const clock_sync* cs )
+{
+   uint16_t best = cs->samples[0].delay;
+
+   for( int i = 1; i < cs->num_samples; i++ ) {
+      if( cs->samples[i].delay < best ) {
+         best = cs->samples[i].delay;
+      }
+   }
+   return best;
+}
+
+// How much to trust a sample - lower is better.  A long round trip
+// can hide an offset error of up to half of it, and an old sample has
+// had time to drift by however wrong the skew is.
+static uint32_t score( const clock_sync_sample* s, uint32_t now )
+{
+   return s->delay + ( now - s->local ) / SAMPLE_AGE_DIVISOR;
+}
+
+// Re-pick the best sample and refit the skew.
+static void update_estimate( clock_sync* cs, uint32_t now )
+{
+   const clock_sync_sample* best = &cs->samples[0];
+   uint16_t max_delay = best->delay;
+   uint16_t cutoff;
+   int64_t sum_x = 0;
+   int64_t sum_y = 0;
+   int64_t sxx = 0;
+   int64_t sxy = 0;
+   int32_t min_x = 0;
+   int32_t max_x = 0;
+   int n = 0;
+
+   for( int i = 1; i < cs->num_samples; i++ ) {
+      if( score( &cs->samples[i], now ) < score( best, now ) ) {
+         best = &cs->samples[i];
+      }
+   }
+   for( int i = 0; i < cs->num_samples; i++ ) {
+      if( cs->samples[i].delay > max_delay ) {
+         max_delay = cs->samples[i].delay;
+      }
+   }
+   cs->offset = best->offset;
+   cs->ref_local = best->local;
+
+   cutoff = best->delay + ( max_delay - best->delay ) / 2;
+   if( cutoff < best->delay + SKEW_DELAY_SLACK_MS ) {
+      cutoff = best->delay + SKEW_DELAY_SLACK_MS;
+   }
+
+   // Fit offset against time, both relative to the best sample so the
+   // sums stay small.
+   for( int i = 0; i < cs->num_samples; i++ ) {
+      const clock_sync_sample* s = &cs->samples[i];
+      if( s->delay <= cutoff ) {
+         int32_t x = (int32_t) ( s->local - best->local );
+         sum_x += x;
+         sum_y += (int32_t) ( s->offset - best->offset );
+         if( n == 0 || x < min_x ) {
+            min_x = x;
+         }
+         if( n == 0 || x > max_x ) {
+            max_x = x;
+         }
+         n++;
+      }
+   }
+   if( n < 3 || max_x - min_x < SKEW_MIN_SPAN_MS ) {
+      return;
+   }
+
+   for( int i = 0; i < cs->num_samples; i++ ) {
+      const clock_sync_sample* s = &cs->samples[i];
+      if( s->delay <= cutoff ) {
+         int64_t dx = (int64_t) (int32_t) ( s->local - best->local ) * n
+            - sum_x;
+         int64_t dy = (int64_t) (int32_t) ( s->offset - best->offset ) * n
+            - sum_y;
+         sxx += dx * dx / n;
+         sxy += dx * dy / n;
+      }
+   }
+   if( sxx > 0 ) {
+      int64_t skew = sxy * 1000000 / sxx;
+      if( skew > CLOCK_SYNC_MAX_SKEW_PPM ) {
+         skew = CLOCK_SYNC_MAX_SKEW_PPM;
+      } else if( skew < - CLOCK_SYNC_MAX_SKEW_PPM ) {
+         skew = - CLOCK_SYNC_MAX_SKEW_PPM;
+      }
+      cs->skew_ppm = (int32_t) skew;
+   }
+}
+
+uint8_t clock_sync_handle_response( clock_sync* cs,
+                                    const uint8_t* resp,
+                                    uint16_t len,
+                                    uint32_t t4,
+                                    uint8_t* msg )
+{
+   clock_sync_sample* s;
+   uint32_t t1;
+   uint32_t t2;
+   uint32_t t3;
+   int32_t delay;
+   int32_t residual;
+
+   if(    len < RESPONSE_LEN
+       || resp[0] != CLOCK_SYNC_MSG_RESPONSE ) {
+      return 0;
+   }
+   // Only the answer to the request in flight counts; a late answer
+   // to a lost one has a delay nobody can vouch for.
+   if( ! cs->outstanding || resp[1] != cs->request_id ) {
+      cs->stats.rejected++;
+      return 0;
+   }
+   cs->outstanding = false;
+   cs->stats.responses++;
+
+   t1 = get_u32( &resp[2] );
+   t2 = get_u32( &resp[6] );
+   t3 = get_u32( &resp[10] );
+
+   delay = (int32_t) ( t4 - t1 ) - (int32_t) ( t3 - t2 );
+   if( delay < 0 || delay > CLOCK_SYNC_MAX_DELAY_MS ) {
+      cs->stats.rejected++;
+      return 0;
+   }
+
+   s = &cs->samples[cs->next_sample];
+   s->local = t4;
+   // ( ( t2 - t1 ) + ( t3 - t4 ) ) / 2, kept modular: the clocks can
+   // be any distance apart, but the correction term is small.
+   s->offset = ( t2 - t1 )
+      + ( (int32_t) ( t3 - t2 ) - (int32_t) ( t4 - t1 ) ) / 2;
+   s->delay = delay;
+
+   if( clock_sync_is_synced( cs ) ) {
+      // A sample's offset can be out by up to half of however much
+      // longer its round trip was than the best one, so only count it
+      // against the prediction beyond that.
+      int32_t slack = ( delay - min_delay( cs ) ) / 2;
+      residual = (int32_t) ( s->offset - predicted_offset( cs, t4 ) );
+      cs->stats.last_residual = residual;
+      if( residual < 0 ) {
+         residual = - residual;
+      }
+      if( residual <= CLOCK_SYNC_STABLE_MS + ( slack > 0 ? slack : 0 ) ) {
+         if( cs->poll_interval < CLOCK_SYNC_MAX_POLL_MS ) {
+            cs->poll_interval *= 2;
+         }
+      } else {
+         cs->poll_interval = CLOCK_SYNC_MIN_POLL_MS;
+      }
+   }
+
+   cs->next_sample = ( cs->next_sample + 1 ) % CLOCK_SYNC_SAMPLES;
+   if( cs->num_samples < CLOCK_SYNC_SAMPLES ) {
+      cs->num_samples++;
+   }
+   update_estimate( cs, t4 );
+
+   if( ! clock_sync_is_synced( cs ) ) {
+      return make_request( cs, t4, msg );
+   }
+   return 0;
+}
+
+uint32_t clock_sync_to_shared( const clock_sync* cs, uint32_t local )
+{
+   return local + predicted_offset( cs, local );
+}
+
+uint32_t clock_sync_to_local( const clock_sync* cs, uint32_t shared )
+{
+   // The skew term barely moves over the offset, so one step of
+   // inversion is exact to well under a ms.
+   return shared - predicted_offset( cs, shared - cs->offset );
+}
+
+bool clock_sync_parse_epoch( const uint8_t* msg,
+                             uint16_t len,
+                             uint32_t* epoch,
+                             uint8_t* tempo )
+{
+   if( len < EPOCH_LEN || msg[0] != CLOCK_SYNC_MSG_EPOCH ) {
+      return false;
+   }
+   *epoch = get_u32( &msg[1] );
+   *tempo = msg[5];
+   return true;
+}
@@ -0,0 +1,146 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// clock_sync.h
+//
+// Estimates the offset and skew of our hw_timer clock against a shared
+// reference clock, from NTP-style timestamp exchanges.  In an ensemble
+// the reference is the phone's clock, so every watch that syncs to it
+// also agrees with every other.
+//
+// Each exchange gives four timestamps: t1 (we send), t2 (reference
+// receives), t3 (reference replies), t4 (we receive).  From them,
+//
+//    offset = ( ( t2 - t1 ) + ( t3 - t4 ) ) / 2
+//    delay  = ( t4 - t1 ) - ( t3 - t2 )
+//
+// An exchange that queued somewhere on the way has a long delay and
+// an unreliable offset, so the offset is taken from the sample with
+// the smallest delay of the last CLOCK_SYNC_SAMPLES, with old samples
+// counted as a little slower than they were.  Skew is the
+// least-squares slope of offset against local time over the faster
+// samples.
+//
+// Exchanges are rate-limited.  While acquiring, each response asks
+// straight away for the next.  After that, the poll interval doubles
+// every time a sample agrees with the prediction, up to
+// CLOCK_SYNC_MAX_POLL_MS, and drops back to the minimum when one
+// doesn't.
+//
+// tools/sync_sim.c runs this against a simulated link with delay and
+// jitter, and reports how far apart the watches end up.  The estimate
+// is only as good as the fastest recent exchange is symmetric, so the
+// spread grows with the link's jitter.
+//
+// Messages are little-endian:
+//
+//    REQUEST   we send:  u8 type, u8 id, u32 t1
+//    RESPONSE  reply:    u8 type, u8 id, u32 t1, u32 t2, u32 t3
+//    EPOCH     from the reference: u8 type, u32 epoch, u8 tempo
+//
+// EPOCH is not for the clock itself - it tells an ensemble where beat
+// 0 falls in reference time and at what tempo.  A tempo of 0 means
+// stop.
+//
+// To use this:
+//
+// 1.  Call clock_sync_init().
+//
+// 2.  Call clock_sync_poll() at least every CLOCK_SYNC_TIMEOUT_MS,
+//     from a timer of its own rather than anything that can stop, and
+//     send whatever it returns.  It returns a request at most once per
+//     poll interval, and a lost exchange is only retried from here.
+//
+// 3.  Hand each response to clock_sync_handle_response(), with t4 the
+//     time it arrived, and send whatever it returns.
+//
+// 4.  Once clock_sync_is_synced(), convert with clock_sync_to_local()
+//     and clock_sync_to_shared().
+
+#define CLOCK_SYNC_SAMPLES (16)
+
+// Exchanges it takes to be synced; made back to back.
+#define CLOCK_SYNC_ACQUIRE (8)
+
+#define CLOCK_SYNC_MIN_POLL_MS (2000)
+#define CLOCK_SYNC_MAX_POLL_MS (64000)
+
+// A request not answered in this long is given up on.
+#define CLOCK_SYNC_TIMEOUT_MS (2000)
+
+// A sample this close to the prediction lets the poll interval grow.
+#define CLOCK_SYNC_STABLE_MS (2)
+
+// Exchanges with a round trip longer than this are thrown away.
+#define CLOCK_SYNC_MAX_DELAY_MS (1000)
+
+#define CLOCK_SYNC_MAX_SKEW_PPM (500)
+
+#define CLOCK_SYNC_MAX_MESSAGE (14)
+
+#define CLOCK_SYNC_MSG_REQUEST (0x01)
+#define CLOCK_SYNC_MSG_RESPONSE (0x81)
+#define CLOCK_SYNC_MSG_EPOCH (0x82)
+
+typedef struct {
+   uint32_t local;    // t4
+   uint32_t offset;   // reference - local, modulo 2^32
+   uint16_t delay;
+} clock_sync_sample;
+
+typedef struct {
+   uint32_t requests;
+   uint32_t responses;
+   uint32_t lost;       // timed out
+   uint32_t rejected;   // stale id or delay too long
+   int32_t last_residual;
+} clock_sync_stats;
+
+typedef struct {
+   clock_sync_sample samples[CLOCK_SYNC_SAMPLES];
+   uint8_t num_samples;
+   uint8_t next_sample;
+
+   // The current estimate: reference = local + offset, at ref_local,
+   // drifting by skew_ppm.
+   uint32_t offset;
+   uint32_t ref_local;
+   int32_t skew_ppm;
+
+   // Don't touch!!
+   uint32_t poll_interval;
+   uint32_t last_poll;
+   bool outstanding;
+   uint8_t request_id;
+   clock_sync_stats stats;
+} clock_sync;
+
+void clock_sync_init( clock_sync* cs );
+
+bool clock_sync_is_synced( const clock_sync* cs );
+
+// Returns the length of a request to send now, or 0.
+uint8_t clock_sync_poll( clock_sync* cs, uint32_t now, uint8_t* msg );
+
+// Returns the length of a follow-up request to send now, or 0.
+uint8_t clock_sync_handle_response( clock_sync* cs,
+                                    const uint8_t* resp,
+                                    uint16_t len,
+                                    uint32_t t4,
+                                    uint8_t* msg );
+
+uint32_t clock_sync_to_shared( const clock_sync* cs, uint32_t local );
+
+uint32_t clock_sync_to_local( const clock_sync* cs, uint32_t shared );
+
+bool clock_sync_parse_epoch( const uint8_t* msg,
+                             uint16_t len,
+                             uint32_t* epoch,
+                             uint8_t* tempo );
+
+#endif
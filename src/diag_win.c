@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////
+//
+// diag_win.c
+//
+// Diagnostics window.
+//
+// See diag_win.h for more information.
+//
+
+#include "diag_win.h"
+#include "layout.h"
+
+static Window diag_win;
+static TextLayer title_lay;
+static InverterLayer title_inverter_lay;
+static TextLayer body_lay;
+
+static char body_str[DIAG_WIN_TEXT_SIZE];
+
+static diag_win_fill fill;
+static uint8_t page;
+
+static const layout_item diag_layout[] = {
+   LAYOUT_TITLE_BAR( &title_lay, &title_inverter_lay, "Diagnostics" ),
+   { LAYOUT_TEXT, 0, GTextAlignmentLeft,
+     LAYOUT_RECT( 2, 30, LAYOUT_SCREEN_WIDTH - 4,
+                  LAYOUT_SCREEN_HEIGHT - 30 ),
+     FONT_KEY_GOTHIC_18, body_str, &body_lay },
+};
+
+static void refresh( void )
+{
+   body_str[0] = '\0';
+   if( fill && ! (*fill)( page, body_str, sizeof(body_str) ) ) {
+      page = 0;
+      (*fill)( page, body_str, sizeof(body_str) );
+   }
+   layer_mark_dirty( &body_lay.layer );
+}
+
+static void diag_win_appear( Window* win )
+{
+   refresh();
+}
+
+static void diag_select( ClickRecognizerRef recognizer, Window* win )
+{
+   page++;
+   refresh();
+}
+
+static void diag_click_provider( ClickConfig** config, Window* win )
+{
+   config[BUTTON_ID_SELECT]->click.handler = (ClickHandler) &diag_select;
+}
+
+void diag_win_init_once( diag_win_fill new_fill )
+{
+   fill = new_fill;
+
+   window_init( &diag_win, "Diagnostics" );
+   diag_win.window_handlers.appear = (WindowHandler) &diag_win_appear;
+   window_set_click_config_provider( &diag_win,
+                                     (ClickConfigProvider)
+                                     &diag_click_provider );
+   layout_build( &diag_win.layer,
+                 diag_layout,
+                 ARRAY_LENGTH(diag_layout) );
+}
+
+void diag_win_open( uint8_t new_page )
+{
+   page = new_page;
+   window_stack_push( &diag_win, true );
+}
@@ -0,0 +1,35 @@
+#ifndef DIAG_WIN_H
+#define DIAG_WIN_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// diag_win.h
+//
+// A window of diagnostic text - stack high water, redraw costs and
+// whatever else is worth watching against its budget.
+//
+// The window doesn't know what it shows.  It owns a text buffer, and
+// the fill function you hand it writes a page of the report into the
+// buffer each time the window appears.  Select moves on to the next
+// page, and back to the first after the last.
+//
+// To use this:
+//
+// 1.  Call diag_win_init_once() in your app init function.
+//
+// 2.  Call diag_win_open() to push the window at a page.
+
+#define DIAG_WIN_TEXT_SIZE (160)
+
+// Write page of the report, at most size chars with the NUL, into buf.
+// Return false if there's no such page.
+typedef bool (* diag_win_fill)( uint8_t page, char* buf, uint16_t size );
+
+void diag_win_init_once( diag_win_fill fill );
+
+void diag_win_open( uint8_t page );
+
+#endif
@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////
+//
+// event_storm.c
+//
+// Deterministic event storm schedule.
+//
+// See event_storm.h for more information.
+//
+
+#include "event_storm.h"
+
+const char event_storm_beat_name[] = "beat";
+const char event_storm_frame_name[] = "frame";
+const char event_storm_spin_name[] = "spin";
+const char event_storm_tap_name[] = "tap";
+
+// 255 BPM at four subdivisions is a slot every 58.8 ms.  The phases
+// line every source up on the first event, and again every few
+// seconds after.
+const event_storm_source event_storm_sources[EVENT_STORM_NUM_SOURCES] = {
+   // vibe enqueue and flash/pendulum beat
+   { event_storm_beat_name,  59,   0, 1500 },
+   // pendulum redraw
+   { event_storm_frame_name, 50,   0, 4000 },
+   // spinner repeat: new value, redraw
+   { event_storm_spin_name,  50,   0, 2500 },
+   // tap timeout: two snprintf
+   { event_storm_tap_name,   1000, 0, 1000 },
+};
+
+void event_storm_start( event_storm* storm, uint32_t now )
+{
+   for( uint8_t s = 0; s < EVENT_STORM_NUM_SOURCES; s++ ) {
+      storm->next[s] = now + event_storm_sources[s].phase_ms;
+   }
+}
+
+uint32_t event_storm_next( event_storm* storm, uint8_t source )
+{
+   uint32_t deadline = storm->next[source];
+
+   storm->next[source] += event_storm_sources[source].period_ms;
+   return deadline;
+}
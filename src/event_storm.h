@@ -0,0 +1,63 @@
+#ifndef EVENT_STORM_H
+#define EVENT_STORM_H
+
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// event_storm.h
+//
+// The worst moment we know of, as a deterministic schedule: the beat
+// at 255 BPM with four subdivisions, pendulum frames, the spinner's
+// 50 ms fast-repeat and the tap timeout, all on fixed periods from a
+// common start so they collide the same way every run.
+//
+// The same table drives the stress mode on the watch (see stress.h),
+// where the beat and frames are the real thing and the rest are
+// stand-ins doing the same work, and tools/latency_stress.c, which
+// runs the schedule through a model of the event loop on the host
+// using the per-event work estimates below.
+
+#define EVENT_STORM_TEMPO (255)
+#define EVENT_STORM_SUBDIVISIONS (4)
+#define EVENT_STORM_DURATION_MS (30000)
+
+typedef enum {
+   EVENT_STORM_BEAT = 0,
+   EVENT_STORM_FRAME,
+   EVENT_STORM_SPIN,
+   EVENT_STORM_TAP,
+   EVENT_STORM_NUM_SOURCES
+} event_storm_source_id;
+
+// The sources' names.  The real beat, frames, spinner and tap timeout
+// name their timers with these too, so in timer_stack's latency stats
+// a stand-in shares its row with the thing it stands in for.
+extern const char event_storm_beat_name[];
+extern const char event_storm_frame_name[];
+extern const char event_storm_spin_name[];
+extern const char event_storm_tap_name[];
+
+typedef struct {
+   const char* name;
+   uint16_t period_ms;
+   uint16_t phase_ms;
+   // Host model only: how long handling one event takes.  The watch
+   // measures the real thing.
+   uint16_t work_us;
+} event_storm_source;
+
+extern const event_storm_source
+event_storm_sources[EVENT_STORM_NUM_SOURCES];
+
+typedef struct {
+   uint32_t next[EVENT_STORM_NUM_SOURCES];
+} event_storm;
+
+void event_storm_start( event_storm* storm, uint32_t now );
+
+// The deadline of source's next event.  Deadlines are absolute and
+// step by exactly one period, however late the last one was handled.
+uint32_t event_storm_next( event_storm* storm, uint8_t source );
+
+#endif
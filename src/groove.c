@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////
+//
+// groove.c
+//
+// Swing / push / custom micro-timing templates.
+//
+// See groove.h for more information.
+//
+
+#include "groove.h"
+
+#include <string.h>
+
+void groove_template_init( groove_template* tmpl )
+{
+   memset( tmpl, 0, sizeof(*tmpl) );
+   tmpl->subdivisions = 1;
+   tmpl->swing_pct = GROOVE_MIN_SWING_PCT;
+}
+
+static int8_t clamp8( int8_t val, int8_t lo, int8_t hi )
+{
+   return ( val < lo ) ? lo : ( ( val > hi ) ? hi : val );
+}
+
+void groove_template_clamp( groove_template* tmpl )
+{
+   if( tmpl->subdivisions < 1 ) {
+      tmpl->subdivisions = 1;
+   } else if( tmpl->subdivisions > GROOVE_MAX_SLOTS ) {
+      tmpl->subdivisions = GROOVE_MAX_SLOTS;
+   }
+
+   if( tmpl->swing_pct < GROOVE_MIN_SWING_PCT ) {
+      tmpl->swing_pct = GROOVE_MIN_SWING_PCT;
+   } else if( tmpl->swing_pct > GROOVE_MAX_SWING_PCT ) {
+      tmpl->swing_pct = GROOVE_MAX_SWING_PCT;
+   }
+
+   tmpl->shift_ms = clamp8( tmpl->shift_ms,
+                            -GROOVE_MAX_SHIFT_MS,
+                            GROOVE_MAX_SHIFT_MS );
+
+   for( int s = 0; s < GROOVE_MAX_SLOTS; s++ ) {
+      tmpl->custom_pct[s] = clamp8( tmpl->custom_pct[s],
+                                    -GROOVE_MAX_CUSTOM_PCT,
+                                    GROOVE_MAX_CUSTOM_PCT );
+   }
+}
+
+bool groove_is_straight( const groove_template* tmpl )
+{
+   if(    ( tmpl->subdivisions & 1 ) == 0
+       && tmpl->swing_pct != GROOVE_MIN_SWING_PCT ) {
+      return false;
+   }
+
+   if( tmpl->shift_ms != 0 ) {
+      return false;
+   }
+
+   for( int s = 0; s < tmpl->subdivisions; s++ ) {
+      if( tmpl->custom_pct[s] != 0 ) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+uint32_t groove_interval_q8( uint8_t tempo )
+{
+   if( tempo == 0 ) {
+      tempo = 1;
+   }
+
+   // tempo = beats per min; 60,000 ms per min.  Q8 keeps the
+   // remainder the integer division used to throw away.
+   return ( 60000UL << 8 ) / tempo;
+}
+
+void groove_build( groove_table* tab,
+                   const groove_template* tmpl,
+                   uint8_t tempo )
+{
+   uint8_t subdivs = tmpl->subdivisions;
+   int32_t subdiv_q8;
+   int32_t gap_q8;
+   bool swing;
+
+   if( subdivs < 1 || subdivs > GROOVE_MAX_SLOTS ) {
+      subdivs = 1;
+   }
+
+   tab->interval_q8 = groove_interval_q8( tempo );
+   tab->num_slots = subdivs;
+
+   subdiv_q8 = tab->interval_q8 / subdivs;
+   gap_q8 = subdiv_q8 * GROOVE_MIN_GAP_PCT / 100;
+   swing = ( ( subdivs & 1 ) == 0 );
+
+   for( int s = 0; s < subdivs; s++ ) {
+      int32_t offset;
+
+      if( swing && ( s & 1 ) ) {
+         // Off-beat of a pair: swing_pct of the way through the pair.
+         offset = ( s - 1 ) * subdiv_q8
+                + (int32_t) ( ( 2 * (int64_t) subdiv_q8
+                                * tmpl->swing_pct ) / 100 );
+      } else {
+         offset = s * subdiv_q8;
+      }
+
+      offset += ( subdiv_q8 * tmpl->custom_pct[s] ) / 100;
+      offset += (int32_t) tmpl->shift_ms << 8;
+
+      // The beat plays its slots in order, so they must stay in
+      // order: after the last slot, and before the next beat.
+      if( s > 0 ) {
+         int32_t first = tab->slot_offset_q8[s - 1] + gap_q8;
+         int32_t last = tab->slot_offset_q8[0]
+                      + (int32_t) tab->interval_q8
+                      - ( subdivs - s ) * gap_q8;
+
+         if( offset < first ) {
+            offset = first;
+         } else if( offset > last ) {
+            offset = last;
+         }
+      }
+
+      tab->slot_offset_q8[s] = offset;
+   }
+}
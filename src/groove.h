@@ -0,0 +1,91 @@
+#ifndef GROOVE_H
+#define GROOVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// groove.h
+//
+// Micro-timing templates for the beat grid: swing, push/lay-back and
+// custom per-subdivision offsets.
+//
+// A groove_template is what the user edits.  It splits each beat into
+// 1 to GROOVE_MAX_SLOTS events ("slots") and says how far each slot
+// is pushed or pulled from its straight position.
+//
+// A groove_table is what the beat scheduler uses.  groove_build()
+// turns a template plus a tempo into a table of slot offsets from the
+// beat's grid point, in ms Q24.8 fixed point.  Build it when the
+// tempo or template changes - never at beat time.  Scheduling a slot
+// is then one table lookup added to the absolute time of the beat:
+//
+//    event_time = beat_time + tab.slot_offset_q8[slot]
+//
+// Because offsets are always measured from the absolute grid and
+// never from the previous event, a swung or pushed event can't drag
+// the grid along with it, so swing never accumulates drift.
+//
+// The template fields:
+//
+// subdivisions - events per beat.  2 = eighths, 3 = triplets,
+//     4 = sixteenths.
+//
+// swing_pct - where the off-beat of each pair of subdivisions falls,
+//     as a percentage of the pair.  50 is straight, 67 is triplet
+//     swing, 75 is a dotted-eighth shuffle.  Ignored for odd
+//     subdivisions.
+//
+// shift_ms - pushes (negative) or lays back (positive) every event by
+//     a fixed number of ms, whatever the tempo.
+//
+// custom_pct - an extra per-slot offset, as a percentage of one
+//     subdivision.  This is how you build grooves that swing and
+//     shift can't describe.
+//
+// However they're set, the slots stay in order: groove_build() keeps
+// each at least GROOVE_MIN_GAP_PCT of a subdivision after the one
+// before, and as far before the next beat's first slot.
+
+#define GROOVE_MAX_SLOTS (4)
+
+#define GROOVE_MIN_SWING_PCT (50)
+#define GROOVE_MAX_SWING_PCT (75)
+#define GROOVE_MAX_SHIFT_MS (30)
+#define GROOVE_MAX_CUSTOM_PCT (50)
+#define GROOVE_MIN_GAP_PCT (25)
+
+typedef struct {
+   uint8_t subdivisions;
+   uint8_t swing_pct;
+   int8_t shift_ms;
+   int8_t custom_pct[GROOVE_MAX_SLOTS];
+} groove_template;
+
+typedef struct {
+   uint8_t num_slots;
+   // Length of one beat, ms Q24.8.
+   uint32_t interval_q8;
+   // When each slot falls, relative to the beat's grid point, ms
+   // Q24.8.  Can be negative for a pushed downbeat.
+   int32_t slot_offset_q8[GROOVE_MAX_SLOTS];
+} groove_table;
+
+// Straight quarter notes - what beat() has always played.
+void groove_template_init( groove_template* tmpl );
+
+// Keep every field of the template in range.
+void groove_template_clamp( groove_template* tmpl );
+
+bool groove_is_straight( const groove_template* tmpl );
+
+// Length of one beat at tempo (bpm), ms Q24.8.
+uint32_t groove_interval_q8( uint8_t tempo );
+
+// Precompute the slot offsets for tempo (bpm, > 0).
+void groove_build( groove_table* tab,
+                   const groove_template* tmpl,
+                   uint8_t tempo );
+
+#endif
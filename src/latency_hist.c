@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////
+//
+// latency_hist.c
+//
+// Latency histogram.
+//
+// See latency_hist.h for more information.
+//
+
+#include "latency_hist.h"
+
+#include <string.h>
+
+static uint8_t bucket_of( uint16_t ms )
+{
+   uint16_t b;
+
+   if( ms < LATENCY_HIST_FINE_MS ) {
+      return ms;
+   }
+   b = LATENCY_HIST_FINE_MS
+      + ( ms - LATENCY_HIST_FINE_MS ) / LATENCY_HIST_COARSE_MS;
+   return ( b < LATENCY_HIST_BUCKETS ) ? b : LATENCY_HIST_BUCKETS - 1;
+}
+
+// The largest latency that lands in bucket b.
+static uint16_t bucket_top( uint8_t b )
+{
+   if( b < LATENCY_HIST_FINE_MS ) {
+      return b;
+   }
+   return LATENCY_HIST_FINE_MS
+      + ( b - LATENCY_HIST_FINE_MS + 1 ) * LATENCY_HIST_COARSE_MS - 1;
+}
+
+void latency_hist_reset( latency_hist* hist )
+{
+   memset( hist, 0, sizeof(*hist) );
+}
+
+void latency_hist_add( latency_hist* hist, int32_t ms )
+{
+   uint8_t b;
+
+   if( ms < 0 ) {
+      ms = 0;
+   } else if( ms > UINT16_MAX ) {
+      ms = UINT16_MAX;
+   }
+   b = bucket_of( ms );
+
+   if( hist->counts[b] < UINT16_MAX ) {
+      hist->counts[b]++;
+   }
+   hist->total++;
+   if( ms > hist->max_ms ) {
+      hist->max_ms = ms;
+   }
+}
+
+uint16_t latency_hist_percentile( const latency_hist* hist, uint8_t pct )
+{
+   uint32_t want;
+   uint32_t seen = 0;
+
+   if( hist->total == 0 ) {
+      return 0;
+   }
+   // The sample at or above pct percent of them, rounding up.
+   want = ( hist->total * pct + 99 ) / 100;
+
+   for( uint8_t b = 0; b < LATENCY_HIST_BUCKETS; b++ ) {
+      seen += hist->counts[b];
+      if( seen >= want ) {
+         // The last bucket has no top; the max is the honest answer.
+         if( b == LATENCY_HIST_BUCKETS - 1 || bucket_top( b ) > hist->max_ms ) {
+            return hist->max_ms;
+         }
+         return bucket_top( b );
+      }
+   }
+   return hist->max_ms;
+}
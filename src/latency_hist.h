@@ -0,0 +1,37 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// latency_hist.h
+//
+// A small fixed-size histogram of latencies in ms, for finding tail
+// latency (p99, max) without keeping every sample.
+//
+// Buckets are 1 ms wide up to LATENCY_HIST_FINE_MS, where most
+// latencies should land, then LATENCY_HIST_COARSE_MS wide; the last
+// bucket catches everything beyond.  A percentile is reported as the
+// top of the bucket it falls in, so it errs long, never short.  The
+// max is exact.
+
+#define LATENCY_HIST_FINE_MS (32)
+#define LATENCY_HIST_COARSE_MS (8)
+#define LATENCY_HIST_BUCKETS (48)
+
+typedef struct {
+   uint16_t counts[LATENCY_HIST_BUCKETS];
+   uint32_t total;
+   uint16_t max_ms;
+} latency_hist;
+
+void latency_hist_reset( latency_hist* hist );
+
+// Negative latencies (finished before the deadline) count as 0.
+void latency_hist_add( latency_hist* hist, int32_t ms );
+
+// pct in 1..100.  0 if nothing has been added.
+uint16_t latency_hist_percentile( const latency_hist* hist, uint8_t pct );
+
+#endif
@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////
+//
+// layout.c
+//
+// Builds a window's layers from a const layout table.
+//
+// See layout.h for more information.
+//
+
+#include "layout.h"
+
+void layout_build( Layer* parent,
+                   const layout_item* items,
+                   uint8_t num_items )
+{
+   for( uint8_t i = 0; i < num_items; i++ ) {
+      const layout_item* item = &items[i];
+      Layer* lay;
+
+      if( item->kind == LAYOUT_INVERTER ) {
+         InverterLayer* inv = (InverterLayer*) item->layer;
+         inverter_layer_init( inv, item->frame );
+         lay = (Layer*) inv;
+      } else {
+         TextLayer* text = (TextLayer*) item->layer;
+         text_layer_init( text, item->frame );
+         text_layer_set_font( text,
+                              fonts_get_system_font( item->font_key ) );
+         text_layer_set_text_alignment( text,
+                                        (GTextAlignment) item->alignment );
+         if( item->text ) {
+            text_layer_set_text( text, item->text );
+         }
+         lay = &text->layer;
+      }
+
+      layer_add_child( parent, lay );
+      if( item->flags & LAYOUT_HIDDEN ) {
+         layer_set_hidden( lay, true );
+      }
+   }
+}
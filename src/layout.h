@@ -0,0 +1,60 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pebble_fonts.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// layout.h
+//
+// Table-driven window layout.
+//
+// Setting up a text layer by hand is an init / set_font /
+// set_text_alignment / set_text / layer_add_child sequence, and every
+// window repeats it for every layer.  Instead, describe the window's
+// layers in a const table of layout_item and build them all with one
+// call to layout_build().  The table lives in read-only data and the
+// code to walk it exists once.
+//
+// GRect() isn't a constant expression, so write frames in tables with
+// LAYOUT_RECT().
+
+#define LAYOUT_SCREEN_WIDTH (144)  // px
+#define LAYOUT_SCREEN_HEIGHT (141) // px
+
+#define LAYOUT_RECT(x, y, w, h) { { (x), (y) }, { (w), (h) } }
+
+typedef enum {
+   LAYOUT_TEXT = 0,
+   LAYOUT_INVERTER,
+} layout_kind;
+
+// layout_item.flags
+#define LAYOUT_HIDDEN (0x01)
+
+typedef struct {
+   uint8_t kind;
+   uint8_t flags;
+   uint8_t alignment;        // GTextAlignment, LAYOUT_TEXT only
+   GRect frame;
+   const char* font_key;     // LAYOUT_TEXT only
+   const char* text;         // LAYOUT_TEXT only; may be NULL
+   void* layer;              // TextLayer* or InverterLayer*
+} layout_item;
+
+// The inverted title bar across the top of a window.
+#define LAYOUT_TITLE_BAR(text_layer, inverter_layer, text)               \
+   { LAYOUT_TEXT, 0, GTextAlignmentCenter,                               \
+     LAYOUT_RECT( 0, 0, LAYOUT_SCREEN_WIDTH, 28 ),                       \
+     FONT_KEY_ROBOTO_CONDENSED_21, (text), (text_layer) },               \
+   { LAYOUT_INVERTER, 0, 0,                                              \
+     LAYOUT_RECT( 0, 0, LAYOUT_SCREEN_WIDTH, 30 ),                       \
+     NULL, NULL, (inverter_layer) }
+
+void layout_build( Layer* parent,
+                   const layout_item* items,
+                   uint8_t num_items );
+
+#endif
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////
+//
+// library.c
+//
+// Cursor-based streaming reads of the LIBRARY resource.
+//
+// See library.h for more information.
+//
+
+#include "library.h"
+#include "resource_ids.auto.h"
+
+#define HEADER_SIZE (12)
+#define LIBRARY_VERSION (1)
+
+static ResHandle library_res;
+static uint16_t num_songs;
+static uint16_t num_setlists;
+
+static uint16_t get_u16( const uint8_t* p )
+{
+   return p[0] | ( p[1] << 8 );
+}
+
+static uint32_t get_u32( const uint8_t* p )
+{
+   return p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (uint32_t) p[3] << 24 );
+}
+
+static bool read_at( uint32_t offset, uint8_t* dst, size_t len )
+{
+   return resource_load_byte_range( library_res, offset, dst, len ) == len;
+}
+
+// Fetch the next len bytes for the cursor, refilling its buffer from
+// the resource when it runs dry.
+static bool cursor_read( library_cursor* cur, uint8_t* dst, uint8_t len )
+{
+   if( cur->buf_pos + len > cur->buf_len ) {
+      size_t got = resource_load_byte_range( library_res,
+                                             cur->offset,
+                                             cur->buf,
+                                             LIBRARY_CURSOR_BUF_SIZE );
+      cur->buf_pos = 0;
+      cur->buf_len = got;
+      if( got < len ) {
+         return false;
+      }
+   }
+
+   memcpy( dst, &cur->buf[cur->buf_pos], len );
+   cur->buf_pos += len;
+   cur->offset += len;
+   return true;
+}
+
+static bool record_offset( uint16_t record, uint32_t* offset )
+{
+   uint8_t slot[4];
+
+   if( ! read_at( HEADER_SIZE + 4 * record, slot, sizeof(slot) ) ) {
+      return false;
+   }
+   *offset = get_u32( slot );
+   return true;
+}
+
+// Open a record and read its name (if name is non-NULL) and item
+// count.
+static uint8_t open_record( uint16_t record,
+                            library_cursor* cur,
+                            char* name )
+{
+   uint8_t name_len;
+   char skip[LIBRARY_MAX_NAME];
+
+   memset( cur, 0, sizeof(*cur) );
+   if( ! record_offset( record, &cur->offset ) ) {
+      return 0;
+   }
+
+   if(    ! cursor_read( cur, &name_len, 1 )
+       || name_len > LIBRARY_MAX_NAME
+       || ! cursor_read( cur, (uint8_t*) ( name ? name : skip ), name_len )
+       || ! cursor_read( cur, &cur->remaining, 1 ) ) {
+      return 0;
+   }
+
+   if( name ) {
+      name[name_len] = '\0';
+   }
+   return cur->remaining;
+}
+
+bool library_init_once( void )
+{
+   uint8_t header[HEADER_SIZE];
+
+   num_songs = 0;
+   num_setlists = 0;
+
+   library_res = resource_get_handle( RESOURCE_ID_LIBRARY );
+   if(    ! read_at( 0, header, sizeof(header) )
+       || memcmp( header, "PBNL", 4 ) != 0
+       || header[4] != LIBRARY_VERSION ) {
+      return false;
+   }
+
+   num_songs = get_u16( &header[6] );
+   num_setlists = get_u16( &header[8] );
+   return true;
+}
+
+uint16_t library_num_songs( void )
+{
+   return num_songs;
+}
+
+uint16_t library_num_setlists( void )
+{
+   return num_setlists;
+}
+
+bool library_song_name( uint16_t song, char* name )
+{
+   library_cursor cur;
+
+   name[0] = '\0';
+   return song < num_songs && open_record( song, &cur, name ) > 0;
+}
+
+bool library_setlist_name( uint16_t setlist, char* name )
+{
+   library_cursor cur;
+
+   name[0] = '\0';
+   return    setlist < num_setlists
+          && open_record( num_songs + setlist, &cur, name ) > 0;
+}
+
+uint8_t library_open_song( uint16_t song, library_cursor* cur )
+{
+   if( song >= num_songs ) {
+      return 0;
+   }
+   return open_record( song, cur, NULL );
+}
+
+bool library_next_section( library_cursor* cur, library_section* sec )
+{
+   if( cur->remaining == 0 ) {
+      return false;
+   }
+   cur->remaining--;
+   return cursor_read( cur, (uint8_t*) sec, sizeof(*sec) );
+}
+
+uint8_t library_open_setlist( uint16_t setlist, library_cursor* cur )
+{
+   if( setlist >= num_setlists ) {
+      return 0;
+   }
+   return open_record( num_songs + setlist, cur, NULL );
+}
+
+bool library_next_setlist_song( library_cursor* cur, uint16_t* song )
+{
+   uint8_t idx[2];
+
+   if( cur->remaining == 0 || ! cursor_read( cur, idx, sizeof(idx) ) ) {
+      return false;
+   }
+   cur->remaining--;
+   *song = get_u16( idx );
+   return true;
+}
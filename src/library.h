@@ -0,0 +1,87 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// library.h
+//
+// Read access to the pattern library and setlists, streamed straight
+// out of the LIBRARY app resource.
+//
+// The library can hold hundreds of songs, so it is never loaded into
+// RAM.  Everything is read on demand with resource_load_byte_range()
+// through a library_cursor, which owns a small fixed-size buffer.
+// However big the library grows, reading it costs the same few dozen
+// bytes.
+//
+// The resource is built from resources/src/library.txt by
+// tools/mklibrary.py.  Its format, all integers little-endian:
+//
+//    header   magic "PBNL", u8 version, u8 flags,
+//             u16 num_songs, u16 num_setlists, u16 reserved
+//    index    u32 offset of each record: the songs, then the
+//             setlists
+//    song     u8 name_len, name, u8 num_sections,
+//             num_sections x library_section (8 bytes each)
+//    setlist  u8 name_len, name, u8 num_songs,
+//             num_songs x u16 song index
+//
+// Opening any record is one 4-byte read of its index slot, then
+// reads straight from the record itself.
+//
+// To use this:
+//
+// 1.  Call library_init_once() once resources are initialized.
+//
+// 2.  Open a song or setlist into a cursor, then read its sections or
+//     song indices one at a time.
+
+#define LIBRARY_MAX_NAME (15)
+#define LIBRARY_CURSOR_BUF_SIZE (32)
+
+typedef struct {
+   uint8_t tempo;
+   uint8_t beats_per_bar;
+   uint8_t beat_unit;
+   // Times the bar is played; 0 repeats it forever.
+   uint8_t bars;
+   uint8_t subdivisions;
+   uint8_t swing_pct;
+   int8_t shift_ms;
+   uint8_t reserved;
+} library_section;
+
+typedef struct {
+   uint32_t offset;         // next byte to read from the resource
+   uint8_t remaining;       // sections / songs left in the record
+   uint8_t buf_pos;
+   uint8_t buf_len;
+   uint8_t buf[LIBRARY_CURSOR_BUF_SIZE];
+} library_cursor;
+
+// Returns false if the resource is missing or not a library.
+bool library_init_once( void );
+
+uint16_t library_num_songs( void );
+uint16_t library_num_setlists( void );
+
+// name must hold LIBRARY_MAX_NAME + 1 chars.
+bool library_song_name( uint16_t song, char* name );
+bool library_setlist_name( uint16_t setlist, char* name );
+
+// Position cur on the first section of song.  Returns the number of
+// sections, or 0 on error.
+uint8_t library_open_song( uint16_t song, library_cursor* cur );
+
+bool library_next_section( library_cursor* cur, library_section* sec );
+
+// Position cur on the first song of setlist.  Returns the number of
+// songs, or 0 on error.
+uint8_t library_open_setlist( uint16_t setlist, library_cursor* cur );
+
+bool library_next_setlist_song( library_cursor* cur, uint16_t* song );
+
+#endif
@@ -0,0 +1,253 @@
+////////////////////////////////////////////////////////////////////////
+//
+// library_win.c
+//
+// Song library and setlist browser.
+//
+// See library_win.h for more information.
+//
+
+#include "library_win.h"
+#include "library.h"
+#include "layout.h"
+
+#include <string.h>
+
+#define SONGS_SECTION (0)
+#define SETLISTS_SECTION (1)
+#define PRESETS_SECTION (2)
+
+static Window library_win;
+static MenuLayer library_menu;
+
+static Window setlist_win;
+static MenuLayer setlist_menu;
+static uint16_t open_setlist;
+
+static library_song_selected on_select;
+
+static const preset_store* presets;
+static library_preset_selected on_preset;
+
+// Only ever holds the name of the row being drawn.
+static char row_name[LIBRARY_MAX_NAME + 1];
+
+static void song_chosen( uint16_t song, uint8_t windows_to_pop )
+{
+   while( windows_to_pop-- > 0 ) {
+      window_stack_pop( true );
+   }
+   if( on_select ) {
+      (*on_select)( song );
+   }
+}
+
+// Pushed presets can land in any slot, so rows skip the empty ones.
+static int preset_slot( uint16_t row )
+{
+   for( int slot = 0; slot < PRESET_MAX_SLOTS; slot++ ) {
+      if( presets->slots[slot].name[0] != '\0' && row-- == 0 ) {
+         return slot;
+      }
+   }
+   return -1;
+}
+
+static uint16_t num_presets( void )
+{
+   uint16_t n = 0;
+
+   for( int slot = 0; slot < PRESET_MAX_SLOTS; slot++ ) {
+      if( presets->slots[slot].name[0] != '\0' ) {
+         n++;
+      }
+   }
+   return n;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Library: songs, setlists, then presets from the phone.
+
+static uint16_t library_num_sections( MenuLayer* menu, void* ctx )
+{
+   return ( presets && num_presets() > 0 ) ? 3 : 2;
+}
+
+static uint16_t library_num_rows( MenuLayer* menu,
+                                  uint16_t section,
+                                  void* ctx )
+{
+   switch( section ) {
+   case SONGS_SECTION:
+      return library_num_songs();
+   case SETLISTS_SECTION:
+      return library_num_setlists();
+   default:
+      return num_presets();
+   }
+}
+
+static int16_t library_header_height( MenuLayer* menu,
+                                      uint16_t section,
+                                      void* ctx )
+{
+   return MENU_CELL_BASIC_HEADER_HEIGHT;
+}
+
+static void library_draw_header( GContext* gctx,
+                                 Layer* cell,
+                                 uint16_t section,
+                                 void* ctx )
+{
+   static const char* const headers[] = { "Songs", "Setlists", "Phone" };
+   menu_cell_basic_header_draw( gctx, cell, headers[section] );
+}
+
+static void library_draw_row( GContext* gctx,
+                              Layer* cell,
+                              MenuIndex* idx,
+                              void* ctx )
+{
+   int slot;
+
+   switch( idx->section ) {
+   case SONGS_SECTION:
+      library_song_name( idx->row, row_name );
+      break;
+   case SETLISTS_SECTION:
+      library_setlist_name( idx->row, row_name );
+      break;
+   default:
+      row_name[0] = '\0';
+      slot = preset_slot( idx->row );
+      if( slot >= 0 ) {
+         strncpy( row_name, presets->slots[slot].name, PRESET_NAME_SIZE );
+      }
+      break;
+   }
+   menu_cell_title_draw( gctx, cell, row_name );
+}
+
+static void library_select( MenuLayer* menu,
+                            MenuIndex* idx,
+                            void* ctx )
+{
+   int slot;
+
+   switch( idx->section ) {
+   case SONGS_SECTION:
+      song_chosen( idx->row, 1 );
+      break;
+   case SETLISTS_SECTION:
+      open_setlist = idx->row;
+      menu_layer_reload_data( &setlist_menu );
+      window_stack_push( &setlist_win, true );
+      break;
+   default:
+      slot = preset_slot( idx->row );
+      if( slot >= 0 ) {
+         window_stack_pop( true );
+         if( on_preset ) {
+            (*on_preset)( slot );
+         }
+      }
+      break;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////
+// One setlist's songs.
+
+static bool setlist_song( uint16_t row, uint16_t* song )
+{
+   library_cursor cur;
+
+   if( library_open_setlist( open_setlist, &cur ) <= row ) {
+      return false;
+   }
+   do {
+      if( ! library_next_setlist_song( &cur, song ) ) {
+         return false;
+      }
+   } while( row-- > 0 );
+
+   return true;
+}
+
+static uint16_t setlist_num_rows( MenuLayer* menu,
+                                  uint16_t section,
+                                  void* ctx )
+{
+   library_cursor cur;
+   return library_open_setlist( open_setlist, &cur );
+}
+
+static void setlist_draw_row( GContext* gctx,
+                              Layer* cell,
+                              MenuIndex* idx,
+                              void* ctx )
+{
+   uint16_t song;
+
+   row_name[0] = '\0';
+   if( setlist_song( idx->row, &song ) ) {
+      library_song_name( song, row_name );
+   }
+   menu_cell_title_draw( gctx, cell, row_name );
+}
+
+static void setlist_select( MenuLayer* menu,
+                            MenuIndex* idx,
+                            void* ctx )
+{
+   uint16_t song;
+
+   if( setlist_song( idx->row, &song ) ) {
+      song_chosen( song, 2 );
+   }
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void library_win_init_once( library_song_selected new_on_select,
+                            const preset_store* new_presets,
+                            library_preset_selected new_on_preset )
+{
+   GRect bounds = GRect( 0, 0, LAYOUT_SCREEN_WIDTH, LAYOUT_SCREEN_HEIGHT );
+
+   on_select = new_on_select;
+   presets = new_presets;
+   on_preset = new_on_preset;
+
+   window_init( &library_win, "Library" );
+   menu_layer_init( &library_menu, bounds );
+   menu_layer_set_callbacks( &library_menu, NULL, (MenuLayerCallbacks) {
+      .get_num_sections = &library_num_sections,
+      .get_num_rows = &library_num_rows,
+      .get_header_height = &library_header_height,
+      .draw_header = &library_draw_header,
+      .draw_row = &library_draw_row,
+      .select_click = &library_select,
+   } );
+   menu_layer_set_click_config_onto_window( &library_menu, &library_win );
+   layer_add_child( &library_win.layer,
+                    menu_layer_get_layer( &library_menu ) );
+
+   window_init( &setlist_win, "Setlist" );
+   menu_layer_init( &setlist_menu, bounds );
+   menu_layer_set_callbacks( &setlist_menu, NULL, (MenuLayerCallbacks) {
+      .get_num_rows = &setlist_num_rows,
+      .draw_row = &setlist_draw_row,
+      .select_click = &setlist_select,
+   } );
+   menu_layer_set_click_config_onto_window( &setlist_menu, &setlist_win );
+   layer_add_child( &setlist_win.layer,
+                    menu_layer_get_layer( &setlist_menu ) );
+}
+
+void library_win_open( void )
+{
+   // Presets may have arrived since the last look.
+   menu_layer_reload_data( &library_menu );
+   window_stack_push( &library_win, true );
+}
@@ -0,0 +1,38 @@
+#ifndef LIBRARY_WIN_H
+#define LIBRARY_WIN_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "preset_proto.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// library_win.h
+//
+// Browse the song library, setlists and presets pushed from the phone,
+// and pick one.
+//
+// Rows are drawn straight from the library resource as they scroll
+// into view (see library.h), so browsing a big library costs no more
+// RAM than browsing a small one.
+//
+// To use this:
+//
+// 1.  Call library_init_once(), then library_win_init_once() in your
+//     app init function.
+//
+// 2.  Call library_win_open() to push the browser.  When the user
+//     picks a song, the browser pops itself and calls on_select with
+//     the song's library index, or on_preset with the preset's slot
+//     in the store.
+
+typedef void (* library_song_selected)( uint16_t song );
+typedef void (* library_preset_selected)( uint8_t slot );
+
+void library_win_init_once( library_song_selected on_select,
+                            const preset_store* presets,
+                            library_preset_selected on_preset );
+
+void library_win_open( void );
+
+#endif
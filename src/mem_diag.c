@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////
+//
+// mem_diag.c
+//
+// Stack painting and high-water measurement.
+//
+// See mem_diag.h for more information.
+//
+
+#include "mem_diag.h"
+
+#define PAINT (0xA5)
+
+// Left alone just below the painting code's own frame, which is in
+// use while it paints.  An interrupt taken while painting pushes its
+// frame in here too.
+#define GUARD (64)
+
+static uint8_t* paint_top;
+static uint8_t* paint_bottom;
+
+static uint8_t* stack_pointer( void )
+{
+   uint8_t* sp;
+#if defined(__arm__)
+   __asm__ volatile ( "mov %0, sp" : "=r" (sp) );
+#else
+   // Host builds: close enough to the stack pointer.
+   volatile uint8_t here;
+   sp = (uint8_t*) &here;
+#endif
+   return sp;
+}
+
+void mem_diag_paint_stack( void )
+{
+   volatile uint8_t* p;
+
+   paint_top = stack_pointer() - GUARD;
+   paint_bottom = paint_top - MEM_DIAG_STACK_BUDGET;
+
+   for( p = paint_bottom; p < paint_top; p++ ) {
+      *p = PAINT;
+   }
+}
+
+uint16_t mem_diag_stack_high_water( void )
+{
+   volatile uint8_t* p = paint_bottom;
+
+   if( paint_top == 0 ) {
+      return 0;
+   }
+   while( p < paint_top && *p == PAINT ) {
+      p++;
+   }
+   return paint_top - p;
+}
@@ -0,0 +1,51 @@
+#ifndef MEM_DIAG_H
+#define MEM_DIAG_H
+
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// mem_diag.h
+//
+// Stack high-water measurement by painting.
+//
+// At init, the stack below the caller is filled with a known pattern.
+// Anything that later runs deeper - a callback doing snprintf, an
+// interrupt frame - overwrites some of it, and the deepest overwritten
+// byte is the most stack ever used.  Finding it is a scan of the
+// painted area, so only ask when you want to show it.
+//
+// It can't see everything:
+//
+// -   Painting starts a guard band and mem_diag_paint_stack()'s own
+//     frame below its caller, about 100 B in all.  Callbacks run from
+//     the event loop at about the depth of the app init function, so
+//     their first ~100 B of stack are never counted.  The high water
+//     is an underestimate by that much.
+//
+// -   Only MEM_DIAG_STACK_BUDGET is painted.  Anything deeper isn't
+//     seen at all; a high water at the budget means "at least".
+//
+// Static RAM (globals) is reported at build time instead, by
+// tools/mem_report.py, which also writes its totals into mem_report.h
+// for the Diagnostics window.
+//
+// To use this:
+//
+// 1.  Call mem_diag_paint_stack() first thing in your app init
+//     function, so as little of the stack as possible is in use.
+//
+// 2.  Call mem_diag_stack_high_water() whenever you want to know.
+
+// How much stack below init is painted and watched, in bytes.  This
+// is our stack budget: a high water at or near it means we're close
+// to the end of what we can see, if not of the stack itself.
+#define MEM_DIAG_STACK_BUDGET (1536)
+
+void mem_diag_paint_stack( void );
+
+// Bytes of stack used below the point where mem_diag_paint_stack()
+// was called, at most MEM_DIAG_STACK_BUDGET.
+uint16_t mem_diag_stack_high_water( void );
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+////////////////////////////////////////////////////////////////////////
+//
+// mem_report.h
+//
+// Static RAM as of the last build, for the Diagnostics window.
+//
+// Written by tools/mem_report.py --update from the object files of
+// the last build - don't edit it by hand.  The figures are a build
+// behind: run ./waf build, then tools/mem_report.py --update, then
+// build again.  Until the first update they're all 0.
+//
+// MEM_REPORT_FILES is the biggest users of RAM, one per line, ready
+// to print.
+
+#define MEM_REPORT_BUDGET (8192)
+#define MEM_REPORT_RAM (0)
+#define MEM_REPORT_FLASH (0)
+#define MEM_REPORT_FILES ""
+
+#endif
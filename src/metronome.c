@@ -1,11 +1,35 @@
 #include "timer_stack.h"
 #include "spinner.h"
 #include "hw_timer.h"
+#include "tempo_estimator.h"
+#include "onset_detector.h"
+#include "groove.h"
+#include "pendulum.h"
+#include "big_digits.h"
+#include "layout.h"
+#include "num_editor.h"
+#include "library.h"
+#include "library_win.h"
+#include "preset_proto.h"
+#include "clock_sync.h"
+#include "phone_link.h"
+#include "mem_diag.h"
+#include "mem_report.h"
+#include "diag_win.h"
+#include "event_storm.h"
+#include "stress.h"
+#include "vibe_synth.h"
+#include "beat_sched.h"
+#include "timer_trace.h"
+#include "song_map.h"
+#include "beat_engine.h"
 #include "pebble_os.h"
 #include "pebble_app.h"
 #include "pebble_fonts.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include "resource_ids.auto.h"
 
 #define MY_UUID { 0xA6, 0x42, 0xF2, 0xC8, 0x2D, 0x04, 0x42, 0x97, 0xA0, 0x31, 0xEB, 0xD6, 0x61, 0x76, 0x16, 0x2B }
 PBL_APP_INFO(MY_UUID,
@@ -14,40 +38,64 @@ PBL_APP_INFO(MY_UUID,
              DEFAULT_MENU_ICON,
              APP_INFO_STANDARD_APP);
 
-const uint8_t SCREEN_WIDTH = 144; // px
-const uint8_t SCREEN_HEIGHT = 141; // px
-
 uint8_t tempo;
 uint8_t min_tempo;
 uint8_t max_tempo;
-uint32_t beat_interval;
-
-char tempo_str[4];
-char size_str[9];
 
 Window window;
-TextLayer tempo_layer;
+big_digits tempo_digits;
 TextLayer up_layer;
 TextLayer down_layer;
 TextLayer run_layer;
 Layer visual_beat_layer;
 
+// How the beat is shown: the flashing circle, or one of the pendulum
+// animations.
+typedef enum {
+   VISUAL_FLASH = 0,
+   VISUAL_PENDULUM,
+   VISUAL_SWEEP,
+   NUM_VISUALS
+} visual_style;
+const char* visual_names[NUM_VISUALS] = { "Flash", "Pendulum", "Sweep" };
+uint8_t visual;
+pendulum beat_pendulum;
+
 spinner tempo_spin;
 
 TextLayer bpm_layer;
 const char bpm_str[] = "bpm";
 
-uint8_t num_beats;
-
 Window menu_win;
 SimpleMenuLayer menu_lay;
+void find_tempo_selected( int index, void* context );
 void vibe_active_selected( int index, void* context );
 void stop_after_selected( int index, void* context );
-void fast_increment_selected( int index, void* context );
 void vibe_dur_selected( int index, void* context );
-const uint8_t VIBE_DUR_INDEX = 1;
-const uint8_t STOP_AFTER_INDEX = 2;
+void groove_selected( int index, void* context );
+void visual_selected( int index, void* context );
+void input_selected( int index, void* context );
+void late_selected( int index, void* context );
+void library_selected( int index, void* context );
+void ensemble_selected( int index, void* context );
+void diag_selected( int index, void* context );
+void stress_selected( int index, void* context );
+void trace_selected( int index, void* context );
+const uint8_t VIBE_INDEX = 1;
+const uint8_t VIBE_DUR_INDEX = 2;
+const uint8_t STOP_AFTER_INDEX = 3;
+const uint8_t GROOVE_INDEX = 4;
+const uint8_t VISUAL_INDEX = 5;
+const uint8_t LIBRARY_INDEX = 8;
+const uint8_t ENSEMBLE_INDEX = 9;
+const uint8_t TRACE_INDEX = 12;
 SimpleMenuItem menu_items[] = {
+   {
+      .title = "Find Tempo",
+      .subtitle = NULL,
+      .callback = (SimpleMenuLayerSelectCallback) &find_tempo_selected,
+      .icon = NULL
+   },
    {
       .title = "Vibration",
       .subtitle = "Enabled",
@@ -65,6 +113,60 @@ SimpleMenuItem menu_items[] = {
       .subtitle = "Never",
       .callback = (SimpleMenuLayerSelectCallback) &stop_after_selected,
       .icon = NULL
+   },
+   {
+      .title = "Groove",
+      .subtitle = "Straight",
+      .callback = (SimpleMenuLayerSelectCallback) &groove_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Visual",
+      .subtitle = "Flash",
+      .callback = (SimpleMenuLayerSelectCallback) &visual_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Start/Stop On",
+      .subtitle = "Press",
+      .callback = (SimpleMenuLayerSelectCallback) &input_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Late Beats",
+      .subtitle = "Skip",
+      .callback = (SimpleMenuLayerSelectCallback) &late_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Library",
+      .subtitle = "None",
+      .callback = (SimpleMenuLayerSelectCallback) &library_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Ensemble",
+      .subtitle = "Off",
+      .callback = (SimpleMenuLayerSelectCallback) &ensemble_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Diagnostics",
+      .subtitle = NULL,
+      .callback = (SimpleMenuLayerSelectCallback) &diag_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Stress Test",
+      .subtitle = "255 bpm storm, 30 s",
+      .callback = (SimpleMenuLayerSelectCallback) &stress_selected,
+      .icon = NULL
+   },
+   {
+      .title = "Record Trace",
+      .subtitle = "Idle",
+      .callback = (SimpleMenuLayerSelectCallback) &trace_selected,
+      .icon = NULL
    }
 };
 SimpleMenuSection menu_sect[] = {
@@ -76,44 +178,98 @@ SimpleMenuSection menu_sect[] = {
 };
 
 
-AppTimerHandle beat_timer;
 AppTimerHandle clear_beat_timer;
+
+// What each of our timers is called in timer_stack's latency stats.
+// The beat's own is in beat_engine.c.
+const char flash_source[] = "flash";
+const char sync_source[] = "sync";
+const char* const tap_source = event_storm_tap_name;
 AppContextRef my_ctx;
 
-uint8_t running;
+// The beat carries on under the menu and editors, but it's only drawn
+// while the metronome window is up.
+bool metronome_visible;
 uint8_t draw_beat;
 
 uint8_t vibe_enabled;
 
-static uint32_t vibe_segs[] = { 50 };
-VibePattern vibe_pat = {
-   .durations = vibe_segs,
-   .num_segments = ARRAY_LENGTH(vibe_segs)
+// How each accent feels.  The downbeat is a solid buzz, the other
+// beats a softer one, and subdivisions softer and shorter still.
+const vibe_accent_shape vibe_shapes[VIBE_NUM_ACCENTS] = {
+   [VIBE_ACCENT_DOWNBEAT]    = { .duty_pct = 100, .length_pct = 100 },
+   [VIBE_ACCENT_BEAT]        = { .duty_pct = 60,  .length_pct = 100 },
+   [VIBE_ACCENT_SUBDIVISION] = { .duty_pct = 35,  .length_pct = 50 },
 };
 
-////////////////////////////////////////////////////////////////////////
-// Stop after window
+// The groove being edited.  The beat engine plays a copy, from the
+// next beat boundary on.
+groove_template groove;
 
-Window stop_after_win;
-TextLayer stop_after_lay;
+////////////////////////////////////////////////////////////////////////
+// Settings
+//
+// Every number that's edited with the spinner is described by a
+// num_editor_field table and edited in the shared num_editor window.
 
-char stop_after_str[6];
 uint8_t stop_after;
+char stop_after_str[6];
 char never_str[] = "Never";
-char beats_str[] = "beats";
 
-spinner stop_after_spin;
-uint8_t min_stop_after = 0;
-uint8_t max_stop_after = 64;
-uint8_t init_stop_after = 0;
+uint8_t vibe_dur;
+char vibe_dur_str[4];
+
+#define INIT_STOP_AFTER (0)
+#define INIT_VIBE_DUR (50)
+
+void stop_after_changed( void )
+{
+   beat_engine_set_stop_after( stop_after );
+}
+
+void vibe_changed( void )
+{
+   beat_engine_set_vibe( vibe_enabled, vibe_dur );
+}
 
-spinner stop_after_spin;
+const num_editor_field stop_after_fields[] = {
+   { "Stop After", "beats", never_str, &stop_after, false, 0, 64, NULL }
+};
 
-TextLayer stop_after_title_lay;
-InverterLayer stop_after_title_inverter_lay;
-const char stop_after_title_str[] = "Stop After";
+const num_editor_field vibe_dur_fields[] = {
+   { "Vibe Length", "ms", NULL, &vibe_dur, false, 25, 200, NULL }
+};
 
-TextLayer stop_after_bpm_lay;
+// Custom offsets only make sense for slots the groove has.
+bool groove_slot_2_visible( void ) { return groove.subdivisions > 1; }
+bool groove_slot_3_visible( void ) { return groove.subdivisions > 2; }
+bool groove_slot_4_visible( void ) { return groove.subdivisions > 3; }
+
+const num_editor_field groove_fields[] = {
+   { "Subdivide", "per beat", NULL,
+     &groove.subdivisions, false, 1, GROOVE_MAX_SLOTS, NULL },
+   { "Swing", "%", NULL,
+     &groove.swing_pct, false,
+     GROOVE_MIN_SWING_PCT, GROOVE_MAX_SWING_PCT, NULL },
+   { "Push/Lay Back", "ms", NULL,
+     (uint8_t*) &groove.shift_ms, true,
+     -GROOVE_MAX_SHIFT_MS, GROOVE_MAX_SHIFT_MS, NULL },
+   { "Slot 1", "% of subdiv", NULL,
+     (uint8_t*) &groove.custom_pct[0], true,
+     -GROOVE_MAX_CUSTOM_PCT, GROOVE_MAX_CUSTOM_PCT, NULL },
+   { "Slot 2", "% of subdiv", NULL,
+     (uint8_t*) &groove.custom_pct[1], true,
+     -GROOVE_MAX_CUSTOM_PCT, GROOVE_MAX_CUSTOM_PCT,
+     &groove_slot_2_visible },
+   { "Slot 3", "% of subdiv", NULL,
+     (uint8_t*) &groove.custom_pct[2], true,
+     -GROOVE_MAX_CUSTOM_PCT, GROOVE_MAX_CUSTOM_PCT,
+     &groove_slot_3_visible },
+   { "Slot 4", "% of subdiv", NULL,
+     (uint8_t*) &groove.custom_pct[3], true,
+     -GROOVE_MAX_CUSTOM_PCT, GROOVE_MAX_CUSTOM_PCT,
+     &groove_slot_4_visible }
+};
 
 char* get_str_for_stop_after( void )
 {
@@ -125,208 +281,340 @@ char* get_str_for_stop_after( void )
    }
 }
 
-bool should_stop_beating( uint8_t beats_so_far )
+char groove_str[12];
+
+char* get_str_for_groove( void )
 {
-   if( stop_after > 0 && beats_so_far >= stop_after ) {
-      return true;
+   if( groove_is_straight( &groove ) ) {
+      return "Straight";
+   } else if(    ( groove.subdivisions & 1 ) == 0
+              && groove.swing_pct != GROOVE_MIN_SWING_PCT ) {
+      snprintf( groove_str, 12, "Swing %d%%", groove.swing_pct );
+   } else {
+      snprintf( groove_str, 12, "Custom" );
    }
 
-   return false;
+   return groove_str;
 }
 
-void update_stop_after( void )
+void groove_changed( void )
 {
-   text_layer_set_text( &stop_after_lay, get_str_for_stop_after() );
-   layer_mark_dirty( &stop_after_lay.layer );
+   beat_engine_set_groove( &groove );
 }
 
-void stop_after_up( ClickRecognizerRef recognizer,
-                    void* context )
+////////////////////////////////////////////////////////////////////////
+// Songs from the library
+//
+// The beat engine's song map has the meter and where we are in the bar
+// and song.  Without a song it's one endless section of 4/4.  The
+// section's tempo and groove come back as BEAT_ENGINE_SECTION.
+
+char song_name[LIBRARY_MAX_NAME + 1] = "None";
+
+// Load a library song into the metronome, from its first section.
+void load_song( uint16_t index )
 {
-   if( stop_after < max_stop_after ) {
-      stop_after++;
-      update_stop_after();
+   if( ! beat_engine_load_song( index ) ) {
+      return;
    }
+   library_song_name( index, song_name );
 }
 
-void stop_after_down( ClickRecognizerRef recognizer,
-                    void* context )
+////////////////////////////////////////////////////////////////////////
+// Ensemble: several watches beating together.  Each one syncs its
+// clock to the phone's, and the phone tells them all where beat 0 of a
+// shared grid falls in its time.
+
+bool ensemble_on;
+clock_sync ensemble_clock;
+
+// The shared grid, once the phone has sent it.
+bool ensemble_locked;
+uint32_t ensemble_epoch;
+uint8_t ensemble_tempo;
+
+// Polls the clock while the ensemble is on, beat or no beat: a lost
+// exchange is only retried from a poll.
+AppTimerHandle ensemble_timer;
+
+const char* get_str_for_ensemble( void )
 {
-   if( stop_after > min_stop_after ) {
-      stop_after--;
-      update_stop_after();
+   if( ! ensemble_on ) {
+      return "Off";
    }
+   return clock_sync_is_synced( &ensemble_clock ) ? "Synced" : "Syncing";
 }
 
-void stop_after_win_appear( Window* win )
-{
-   spinner_activate();
-}
+////////////////////////////////////////////////////////////////////////
+// Timer trace.  Records how late the OS fires our timers, and the
+// buttons, for tools/trace_replay.c; the phone reads it back over
+// PHONE_LINK_TRACE_KEY.
 
-void stop_after_win_disappear( Window* win )
+timer_trace trace;
+
+// What the replay looks at.
+const char* const trace_sources[] = {
+   event_storm_beat_name,
+   event_storm_frame_name
+};
+
+const char* get_str_for_trace( void )
 {
-   spinner_deactivate( &stop_after_spin );
+   if( trace.recording ) {
+      return "Recording";
+   }
+   return timer_trace_done( &trace ) ? "Ready for phone" : "Idle";
 }
 
-void stop_after_win_init( void )
+void update_menu( Window* win )
 {
-   stop_after = init_stop_after;
-
-   window_init( &stop_after_win, "Stop After" );
-   stop_after_win.window_handlers.appear =
-      (WindowHandler) &stop_after_win_appear;
-   stop_after_win.window_handlers.disappear =
-      (WindowHandler) &stop_after_win_disappear;
-
-   spinner_init( &stop_after_spin,
-                 &stop_after_win,
-                 stop_after_up,
-                 stop_after_down,
-                 SPIN_NO_ADDITIONAL_CLICK_CONFIG,
-                 my_ctx );
-
-   text_layer_init( &stop_after_title_lay,
-                    GRect( 0, 0, SCREEN_WIDTH, 28 ) );
-   text_layer_set_font( &stop_after_title_lay,
-                        fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-   text_layer_set_text_alignment( &stop_after_title_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &stop_after_title_lay, stop_after_title_str );
-   layer_add_child( &stop_after_win.layer, &stop_after_title_lay.layer );
-
-   inverter_layer_init( &stop_after_title_inverter_lay,
-                        GRect( 0, 0, SCREEN_WIDTH, 30 ) );
-   layer_add_child( &stop_after_win.layer,
-                    (Layer*) &stop_after_title_inverter_lay );
-
-   text_layer_init( &stop_after_lay, GRect( 0, 55, SCREEN_WIDTH, 30 ) );
-   text_layer_set_font( &stop_after_lay,
-                        fonts_get_system_font( FONT_KEY_BITHAM_30_BLACK ) );
-   text_layer_set_text_alignment( &stop_after_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &stop_after_lay, get_str_for_stop_after() );
-   layer_add_child( &stop_after_win.layer, &stop_after_lay.layer );
-   
-   text_layer_init( &stop_after_bpm_lay, GRect( 0, 85, SCREEN_WIDTH, 25 ) );
-   text_layer_set_font( &stop_after_bpm_lay,
-                        fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-   text_layer_set_text_alignment( &stop_after_bpm_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &stop_after_bpm_lay, beats_str );
-   layer_add_child( &stop_after_win.layer, &stop_after_bpm_lay.layer );
- }
+   snprintf( vibe_dur_str, 4, "%d", vibe_dur );
+   menu_items[VIBE_DUR_INDEX].subtitle = vibe_dur_str;
+   menu_items[STOP_AFTER_INDEX].subtitle = get_str_for_stop_after();
+   menu_items[GROOVE_INDEX].subtitle = get_str_for_groove();
+   menu_items[LIBRARY_INDEX].subtitle = song_name;
+   menu_items[ENSEMBLE_INDEX].subtitle = get_str_for_ensemble();
+   menu_items[TRACE_INDEX].subtitle = get_str_for_trace();
+   layer_mark_dirty( (Layer*) &menu_lay );
+}
 
 ////////////////////////////////////////////////////////////////////////
-// Vibe duration window
+// Presets and settings pushed from the phone.  They only live in RAM -
+// there's no storage to keep them in across launches.
 
-Window vibe_dur_win;
-TextLayer vibe_dur_lay;
+preset_store presets;
 
-char vibe_dur_str[4];
-uint8_t vibe_dur;
-
-spinner vibe_dur_spin;
-uint8_t min_vibe_dur = 25;
-uint8_t max_vibe_dur = 200;
-uint8_t init_vibe_dur = 50;
-
-void vibe_dur_up( ClickRecognizerRef recognizer,
-                  void* context )
+void load_preset( uint8_t slot )
 {
-   if( vibe_dur < max_vibe_dur ) {
-      vibe_dur++;
-      snprintf( vibe_dur_str, 4, "%d", vibe_dur );
-      text_layer_set_text( &vibe_dur_lay, vibe_dur_str );
-      layer_mark_dirty( &vibe_dur_lay.layer );
+   const preset* p = &presets.slots[slot];
+   library_section sec = {
+      .tempo = p->tempo,
+      .beats_per_bar = p->beats_per_bar,
+      .beat_unit = p->beat_unit,
+      .subdivisions = p->subdivisions,
+      .swing_pct = p->swing_pct,
+      .shift_ms = p->shift_ms
+   };
+
+   if( sec.tempo < min_tempo || sec.tempo > max_tempo ) {
+      return;
    }
+   if( sec.beats_per_bar == 0 || sec.beat_unit == 0 ) {
+      sec.beats_per_bar = 4;
+      sec.beat_unit = 4;
+   }
+   strncpy( song_name, p->name, LIBRARY_MAX_NAME );
+   song_name[LIBRARY_MAX_NAME] = '\0';
+   beat_engine_load_section( &sec );
 }
 
-void vibe_dur_down( ClickRecognizerRef recognizer,
-                    void* context )
+void apply_pushed_settings( const preset_settings* settings )
 {
-   if( vibe_dur > min_vibe_dur ) {
-      vibe_dur--;
-      snprintf( vibe_dur_str, 4, "%d", vibe_dur );
-      text_layer_set_text( &vibe_dur_lay, vibe_dur_str );
-      layer_mark_dirty( &vibe_dur_lay.layer );
+   if( settings->vibe_dur >= vibe_dur_fields[0].min
+       && settings->vibe_dur <= vibe_dur_fields[0].max ) {
+      vibe_dur = settings->vibe_dur;
+   }
+   if( settings->stop_after <= stop_after_fields[0].max ) {
+      stop_after = settings->stop_after;
    }
+   vibe_enabled = settings->vibe_enabled ? 1 : 0;
+   menu_items[VIBE_INDEX].subtitle =
+      vibe_enabled ? "Enabled" : "Disabled";
+   vibe_changed();
+   stop_after_changed();
+   update_menu( &menu_win );
 }
 
-void vibe_dur_win_appear( Window* win )
+////////////////////////////////////////////////////////////////////////   
+
+void vibe_dur_selected( int index, void* context )
 {
-   spinner_activate();
+   num_editor_open( vibe_dur_fields,
+                    ARRAY_LENGTH(vibe_dur_fields),
+                    &vibe_changed );
 }
 
-void vibe_dur_win_disappear( Window* win )
+void stop_after_selected( int index, void* context )
 {
-   spinner_deactivate( &vibe_dur_spin );
+   num_editor_open( stop_after_fields,
+                    ARRAY_LENGTH(stop_after_fields),
+                    &stop_after_changed );
 }
 
-void update_menu( Window* win )
+void groove_selected( int index, void* context )
 {
-   snprintf( vibe_dur_str, 4, "%d", vibe_dur );
-   menu_items[VIBE_DUR_INDEX].subtitle = vibe_dur_str;
-   menu_items[STOP_AFTER_INDEX].subtitle = get_str_for_stop_after();
-   vibe_segs[0] = vibe_dur;
-   layer_mark_dirty( (Layer*) &menu_lay );
+   num_editor_open( groove_fields,
+                    ARRAY_LENGTH(groove_fields),
+                    &groove_changed );
 }
 
-TextLayer vibe_dur_title_lay;
-InverterLayer vibe_dur_title_inverter_lay;
-const char vibe_dur_title_str[] = "Vibe Length";
+void library_selected( int index, void* context )
+{
+   library_win_open();
+}
 
-void vibe_dur_win_init( void )
+void ensemble_selected( int index, void* context )
 {
-   vibe_dur = init_vibe_dur;
+   uint8_t msg[CLOCK_SYNC_MAX_MESSAGE];
+   uint8_t len;
+
+   ensemble_on = ! ensemble_on;
+   ensemble_locked = false;
+   if( ensemble_on ) {
+      // Start acquiring now, so the clock is good by the time the
+      // phone sends a grid.
+      clock_sync_init( &ensemble_clock );
+      len = clock_sync_poll( &ensemble_clock, hw_timer_get_time(), msg );
+      phone_link_send( PHONE_LINK_SYNC_KEY, msg, len );
+      ensemble_timer = timer_stack_send_event( my_ctx,
+                                               CLOCK_SYNC_TIMEOUT_MS,
+                                               0,
+                                               sync_source );
+   } else {
+      timer_stack_cancel_event( my_ctx, ensemble_timer );
+   }
+   update_menu( &menu_win );
+}
 
-   window_init( &vibe_dur_win, "Vibe Dur" );
-   vibe_dur_win.window_handlers.appear =
-      (WindowHandler) &vibe_dur_win_appear;
-   vibe_dur_win.window_handlers.disappear =
-      (WindowHandler) &vibe_dur_win_disappear;
+////////////////////////////////////////////////////////////////////////
+// Input.  Start can act on the press itself, or on the click, which
+// comes at release.  Stop is on release either way, as select held
+// down is the way into the menu.  The up/down spinner follows suit.
+
+typedef enum {
+   INPUT_PRESS = 0,
+   INPUT_CLICK,
+   NUM_INPUT_MODES
+} input_mode;
+const char* input_mode_names[NUM_INPUT_MODES] = { "Press", "Click" };
+uint8_t input;
+
+// Press to first beat: when select last went down, whether that press
+// started the beat and its first beat is still to come, and how long
+// it's been taking.
+uint32_t press_time;
+bool press_to_beat_pending;
+uint16_t last_press_to_beat;
+latency_hist press_to_beat;
+
+void input_selected( int index, void* context )
+{
+   if( ++input >= NUM_INPUT_MODES ) {
+      input = INPUT_PRESS;
+   }
+   menu_items[index].subtitle = input_mode_names[input];
+   // The click config is set up again when the metronome window
+   // comes back.
+   tempo_spin.press_down = ( input == INPUT_PRESS );
+   latency_hist_reset( &press_to_beat );
+   last_press_to_beat = 0;
+   layer_mark_dirty( (Layer*) &menu_lay );
+}
 
-   spinner_init( &vibe_dur_spin,
-                 &vibe_dur_win,
-                 vibe_dur_up,
-                 vibe_dur_down,
-                 SPIN_NO_ADDITIONAL_CLICK_CONFIG,
-                 my_ctx );
+void late_selected( int index, void* context )
+{
+   beat_sched_recovery recovery = beat_engine_recovery() + 1;
 
-   text_layer_init( &vibe_dur_title_lay,
-                    GRect( 0, 0, SCREEN_WIDTH, 28 ) );
-   text_layer_set_font( &vibe_dur_title_lay,
-                        fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-   text_layer_set_text_alignment( &vibe_dur_title_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &vibe_dur_title_lay, vibe_dur_title_str );
-   layer_add_child( &vibe_dur_win.layer, &vibe_dur_title_lay.layer );
-
-   inverter_layer_init( &vibe_dur_title_inverter_lay,
-                        GRect( 0, 0, SCREEN_WIDTH, 30 ) );
-   layer_add_child( &vibe_dur_win.layer,
-                    (Layer*) &vibe_dur_title_inverter_lay );
-
-   text_layer_init( &vibe_dur_lay, GRect( 0, 55, SCREEN_WIDTH, 30 ) );
-   text_layer_set_font( &vibe_dur_lay,
-                        fonts_get_system_font( FONT_KEY_BITHAM_30_BLACK ) );
-   text_layer_set_text_alignment( &vibe_dur_lay,
-                                  GTextAlignmentCenter );
-   snprintf( vibe_dur_str, 4, "%d", vibe_dur );
-   text_layer_set_text( &vibe_dur_lay, vibe_dur_str );
-   
-   layer_add_child( &vibe_dur_win.layer, &vibe_dur_lay.layer );
- }
+   if( recovery >= BEAT_SCHED_NUM_RECOVERIES ) {
+      recovery = BEAT_SCHED_SKIP;
+   }
+   beat_engine_set_recovery( recovery );
+   menu_items[index].subtitle = beat_sched_recovery_names[recovery];
+   layer_mark_dirty( (Layer*) &menu_lay );
+}
 
-////////////////////////////////////////////////////////////////////////   
+#define DIAG_PAGE_MEMORY (0)
+#define DIAG_PAGE_STATIC_RAM (1)
+#define DIAG_PAGE_LATENCY (2)
+#define DIAG_PAGE_INPUT (3)
+#define DIAG_PAGE_BEATS (4)
 
-void vibe_dur_selected( int index, void* context )
+void diag_selected( int index, void* context )
 {
-   window_stack_push( &vibe_dur_win, true );
+   diag_win_open( DIAG_PAGE_MEMORY );
 }
 
-void stop_after_selected( int index, void* context )
+// What the diagnostics window shows.  Static RAM is only known at
+// build time, so it's whatever tools/mem_report.py last wrote into
+// mem_report.h.
+bool fill_diagnostics( uint8_t page, char* buf, uint16_t size )
 {
-   window_stack_push( &stop_after_win, true );
+   const pendulum_stats* ps = &beat_pendulum.stats;
+   const beat_sched_stats* bs = beat_engine_stats();
+   int len;
+
+   switch( page ) {
+   case DIAG_PAGE_MEMORY:
+      snprintf( buf, size,
+                "Stack: %u / %u B\n"
+                "Frames: %lu drawn\n"
+                "  %lu skipped\n"
+                "  max %u px, %u ms",
+                mem_diag_stack_high_water(), MEM_DIAG_STACK_BUDGET,
+                (unsigned long) ps->frames_drawn,
+                (unsigned long) ps->frames_skipped,
+                ps->max_pixels, ps->max_frame_ms );
+      return true;
+
+   case DIAG_PAGE_STATIC_RAM:
+      if( MEM_REPORT_RAM == 0 ) {
+         snprintf( buf, size,
+                   "Static RAM:\n"
+                   "not reported -\n"
+                   "run mem_report.py\n"
+                   "--update" );
+      } else {
+         snprintf( buf, size,
+                   "Static RAM: %u / %u B\n"
+                   "%s",
+                   MEM_REPORT_RAM, MEM_REPORT_BUDGET,
+                   MEM_REPORT_FILES );
+      }
+      return true;
+
+   case DIAG_PAGE_LATENCY:
+      // Deadline to handler finished, from the last stress test.
+      len = snprintf( buf, size, "Late ms: p99 / max" );
+      for( uint8_t i = 0;
+           i < timer_stack_num_latency() && len < size;
+           i++ ) {
+         const timer_stack_latency* lat = timer_stack_get_latency( i );
+         len += snprintf( buf + len, size - len, "\n%s: %u / %u",
+                          lat->source,
+                          latency_hist_percentile( &lat->hist, 99 ),
+                          lat->hist.max_ms );
+      }
+      return true;
+
+   case DIAG_PAGE_INPUT:
+      snprintf( buf, size,
+                "Press to beat, ms\n"
+                "On: %s\n"
+                "Last: %u\n"
+                "p99: %u  max: %u",
+                input_mode_names[input],
+                last_press_to_beat,
+                latency_hist_percentile( &press_to_beat, 99 ),
+                press_to_beat.max_ms );
+      return true;
+
+   case DIAG_PAGE_BEATS:
+      snprintf( buf, size,
+                "Late beats: %s\n"
+                "Missed: %lu\n"
+                "Worst: %u ms\n"
+                "Dropped: %lu\n"
+                "Shifted: %lu ms",
+                beat_sched_recovery_names[beat_engine_recovery()],
+                (unsigned long) bs->misses,
+                bs->max_late_ms,
+                (unsigned long) bs->dropped,
+                (unsigned long) bs->shifted_ms );
+      return true;
+
+   default:
+      return false;
+   }
 }
 
 void switch_to_menu( ClickRecognizerRef recognizer,
@@ -341,6 +629,35 @@ void vibe_active_selected( int index, void* context )
    vibe_enabled = ! vibe_enabled;
    menu_items[index].subtitle =
       vibe_enabled ? "Enabled" : "Disabled";
+   vibe_changed();
+   layer_mark_dirty( (Layer*) &menu_lay );
+}
+
+void apply_visual( void )
+{
+   layer_set_hidden( &visual_beat_layer, visual != VISUAL_FLASH );
+   pendulum_set_hidden( &beat_pendulum, visual == VISUAL_FLASH );
+
+   if( visual == VISUAL_FLASH ) {
+      pendulum_stop( &beat_pendulum );
+   } else {
+      pendulum_set_style( &beat_pendulum,
+                          ( visual == VISUAL_SWEEP ) ? PENDULUM_SWEEP
+                                                     : PENDULUM_SWING );
+      // Its frames are timed from the metronome window's handler.
+      if( beat_engine_running() && metronome_visible ) {
+         pendulum_start( &beat_pendulum );
+      }
+   }
+}
+
+void visual_selected( int index, void* context )
+{
+   if( ++visual >= NUM_VISUALS ) {
+      visual = VISUAL_FLASH;
+   }
+   menu_items[index].subtitle = visual_names[visual];
+   apply_visual();
    layer_mark_dirty( (Layer*) &menu_lay );
 }
 
@@ -375,10 +692,11 @@ InverterLayer measuring_inverter_lay;
 char measuring_active_str[] = "active";
 char measuring_inactive_str[] = "inactive";
 
-uint8_t num_tap_intervals;
-uint32_t last_tap_time;
-#define MAX_TAP_INTERVALS (4)
-uint32_t tap_intervals[MAX_TAP_INTERVALS];
+tempo_estimator tap_est;
+onset_detector accel_onsets;
+// Rate at which the accelerometer batches handed to
+// find_tempo_accel_batch() were sampled.
+#define ACCEL_SAMPLE_RATE_HZ (50)
 
 AppTimerHandle stop_measuring_timer;
 #define STOP_MEASURING_TIMEOUT (2000)
@@ -400,72 +718,78 @@ bool handle_tempo_tap_timers( AppContextRef app_ctx,
    return true;
 }
 
-void handle_tempo_tap( ClickRecognizerRef recognizer,
-                       Window* win )
+// Common path for every onset, whether it came from the down button
+// or from the accelerometer.  onset_time is in 1ms units.
+void handle_tempo_onset( uint32_t onset_time, void* context )
 {
    if( measuring_tempo ) {
-      // This is in 1ms units.
-      uint32_t tap_time = hw_timer_get_time();
-      uint32_t tap_interval = tap_time - last_tap_time;
-      last_tap_time = tap_time;
-      // Push num ticks, calc curr and avg tempo.
-      if( num_tap_intervals < MAX_TAP_INTERVALS ) {
-         tap_intervals[num_tap_intervals++] = tap_interval;
-      } else {
-         uint32_t sum = tap_intervals[0];
-         uint32_t avg;
-         for( int t = 1; t < MAX_TAP_INTERVALS; t++ ) {
-            sum += tap_intervals[t];
-            tap_intervals[t-1] = tap_intervals[t];
-         }
-         tap_intervals[MAX_TAP_INTERVALS-1] = tap_interval;
-         avg = sum / 4;
-         avg_tempo = 60000 / avg;
+      uint8_t changed = tempo_estimator_add_onset( &tap_est, onset_time );
+      if( changed & TEMPO_EST_AVG_CHANGED ) {
+         avg_tempo = tap_est.avg_tempo;
          snprintf( avg_tempo_str, 4, "%d", avg_tempo );
          text_layer_set_text( &avg_tempo_lay, avg_tempo_str );
       }
-      if( num_tap_intervals > 1 ) {
-         curr_tempo = 60000 / tap_interval;
+      if( changed & TEMPO_EST_CURR_CHANGED ) {
+         curr_tempo = tap_est.curr_tempo;
          snprintf( curr_tempo_str, 4, "%d", curr_tempo );
          text_layer_set_text( &curr_tempo_lay, curr_tempo_str );
       }
    } else {
-      num_tap_intervals = 0;
-      hw_timer_start();
-      last_tap_time = hw_timer_get_time();
+      tempo_estimator_reset( &tap_est, onset_time );
       text_layer_set_text( &measuring_lay, measuring_active_str );
       layer_set_hidden( (Layer*) &measuring_inverter_lay, false );
-      memset( tap_intervals, 0,
-              ARRAY_LENGTH(tap_intervals) * sizeof(*tap_intervals) );
       measuring_tempo = true;
    }
 
-   stop_measuring_timer = app_timer_send_event( my_ctx,
-                                                STOP_MEASURING_TIMEOUT,
-                                                0 );
+   if( stop_measuring_timer != 0 ) {
+      timer_stack_cancel_event( my_ctx, stop_measuring_timer );
+   }
+   stop_measuring_timer = timer_stack_send_event( my_ctx,
+                                                  STOP_MEASURING_TIMEOUT,
+                                                  0,
+                                                  tap_source );
 }
 
-// We use a hardware-supplied timer module for the "find tempo"
-// processing.  PebbleOS 1.12.1 doesn't provide any kind of
-// high-resolution timer/counter facility, so we have no accurate way
-// of measuring time.
+void handle_tempo_tap( ClickRecognizerRef recognizer,
+                       Window* win )
+{
+   handle_tempo_onset( hw_timer_get_time(), NULL );
+}
+
+// Hands-free tempo capture.  Hand this a batch of accelerometer
+// samples, sampled at ACCEL_SAMPLE_RATE_HZ, whose first sample was
+// taken at first_sample_time (hw_timer ms).  Any onsets go down the
+// same path as a tap.  Returns the number of samples consumed, which
+// is at most ONSET_MAX_BATCH so the beat timer is never held up;
+// pass the rest in on the next event.
 //
-// I tried setting up a timer to run at 10ms and just count
-// ticks... but this was incredibly inaccurate and noisy.  Using TIM5,
-// a 32-bit counter, is much better.
+// Nothing calls this yet: PebbleOS 1.x has no accelerometer API for
+// apps.  It's the entry point for the firmware that adds one; until
+// then the detector is exercised on the host by tools/onset_replay.c.
+uint16_t find_tempo_accel_batch( const onset_sample* samples,
+                                 uint16_t num_samples,
+                                 uint32_t first_sample_time )
+{
+   return onset_detector_process( &accel_onsets,
+                                  samples,
+                                  num_samples,
+                                  first_sample_time );
+}
+
+// Tap times come from the hardware timer (see handle_init()).
 void find_tempo_win_appear( Window* win )
 {
    measuring_tempo = false;
-   hw_timer_init( 1000 );
+   stop_measuring_timer = 0;
+   onset_detector_reset( &accel_onsets );
    timer_stack_push( &handle_tempo_tap_timers );
 }
 
 void find_tempo_win_disappear( Window* win )
 {
    if( measuring_tempo ) {
-      app_timer_cancel_event( my_ctx, stop_measuring_timer );
+      timer_stack_cancel_event( my_ctx, stop_measuring_timer );
    }
-   hw_timer_deinit();
    timer_stack_pop();
 }
 
@@ -473,8 +797,8 @@ void use_this_tempo_handler( ClickRecognizerRef recognizer,
                              Window* win )
 {
    tempo = avg_tempo;
-   snprintf( tempo_str, 4, "%d", tempo );
-   layer_mark_dirty( &tempo_layer.layer );
+   big_digits_set_value( &tempo_digits, tempo );
+   beat_engine_set_tempo( tempo );
    window_stack_pop( true );
 }
 
@@ -489,10 +813,47 @@ void find_tempo_win_config_click_provider( ClickConfig** config,
       (ClickHandler) &use_this_tempo_handler;
 }
 
+const layout_item find_tempo_layout[] = {
+   LAYOUT_TITLE_BAR( &find_tempo_title_lay,
+                     &find_tempo_title_inverter_lay,
+                     find_tempo_title_str ),
+   { LAYOUT_TEXT, 0, GTextAlignmentRight,
+     LAYOUT_RECT( LAYOUT_SCREEN_WIDTH - 32, LAYOUT_SCREEN_HEIGHT - 25,
+                  30, 25 ),
+     FONT_KEY_ROBOTO_CONDENSED_21, tap_butt_str, &tap_butt_lay },
+   { LAYOUT_TEXT, 0, GTextAlignmentRight,
+     LAYOUT_RECT( LAYOUT_SCREEN_WIDTH - 32, LAYOUT_SCREEN_HEIGHT / 2 - 5,
+                  30, 25 ),
+     FONT_KEY_ROBOTO_CONDENSED_21, use_butt_str, &use_butt_lay },
+   { LAYOUT_TEXT, 0, GTextAlignmentRight,
+     LAYOUT_RECT( 10, 30, 70, 30 ),
+     FONT_KEY_BITHAM_30_BLACK, "100", &curr_tempo_lay },
+   { LAYOUT_TEXT, 0, GTextAlignmentCenter,
+     LAYOUT_RECT( 80, 42, 30, 18 ),
+     FONT_KEY_GOTHIC_18_BOLD, curr_tempo_name_str, &curr_tempo_name_lay },
+   { LAYOUT_TEXT, 0, GTextAlignmentRight,
+     LAYOUT_RECT( 10, 70, 70, 30 ),
+     FONT_KEY_BITHAM_30_BLACK, "100", &avg_tempo_lay },
+   { LAYOUT_TEXT, 0, GTextAlignmentCenter,
+     LAYOUT_RECT( 80, 82, 30, 21 ),
+     FONT_KEY_GOTHIC_18_BOLD, avg_tempo_name_str, &avg_tempo_name_lay },
+   { LAYOUT_TEXT, 0, GTextAlignmentCenter,
+     LAYOUT_RECT( 20, 110, 65, 28 ),
+     FONT_KEY_GOTHIC_24_BOLD, measuring_inactive_str, &measuring_lay },
+   { LAYOUT_INVERTER, LAYOUT_HIDDEN, 0,
+     LAYOUT_RECT( 20, 114, 65, 24 ),
+     NULL, NULL, &measuring_inverter_lay },
+};
+
 void find_tempo_win_init( void )
 {
    window_init( &find_tempo_win, "Find Tempo" );
 
+   onset_detector_init( &accel_onsets,
+                        ACCEL_SAMPLE_RATE_HZ,
+                        &handle_tempo_onset,
+                        NULL );
+
    window_set_click_config_provider( 
       &find_tempo_win,
       (ClickConfigProvider) &find_tempo_win_config_click_provider );
@@ -502,96 +863,9 @@ void find_tempo_win_init( void )
    find_tempo_win.window_handlers.disappear =
       (WindowHandler) find_tempo_win_disappear;
 
-   text_layer_init( &find_tempo_title_lay,
-                    GRect( 0, 0, SCREEN_WIDTH, 28 ) );
-   text_layer_set_font( &find_tempo_title_lay,
-                        fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-   text_layer_set_text_alignment( &find_tempo_title_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &find_tempo_title_lay, find_tempo_title_str );
-   layer_add_child( &find_tempo_win.layer, &find_tempo_title_lay.layer );
-
-   inverter_layer_init( &find_tempo_title_inverter_lay,
-                        GRect( 0, 0, SCREEN_WIDTH, 30 ) );
-   layer_add_child( &find_tempo_win.layer,
-                    (Layer*) &find_tempo_title_inverter_lay );
-
-   text_layer_init( &tap_butt_lay,
-                    GRect( SCREEN_WIDTH - 32, SCREEN_HEIGHT - 25,
-                           30, 25 ) );
-   text_layer_set_font( &tap_butt_lay,
-                        fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-   text_layer_set_text_alignment( &tap_butt_lay,
-                                  GTextAlignmentRight );
-   text_layer_set_text( &tap_butt_lay, tap_butt_str );
-   layer_add_child( &find_tempo_win.layer, &tap_butt_lay.layer );
-
-   text_layer_init( &use_butt_lay,
-                    GRect( SCREEN_WIDTH - 32, SCREEN_HEIGHT / 2 - 5,
-                           30, 25 ) );
-   text_layer_set_font( &use_butt_lay,
-                        fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-   text_layer_set_text_alignment( &use_butt_lay,
-                                  GTextAlignmentRight );
-   text_layer_set_text( &use_butt_lay, use_butt_str );
-   layer_add_child( &find_tempo_win.layer, &use_butt_lay.layer );
-
-   text_layer_init( &curr_tempo_lay,
-                    GRect( 10, 30,
-                           70, 30 ) );
-   text_layer_set_font( &curr_tempo_lay,
-                        fonts_get_system_font( FONT_KEY_BITHAM_30_BLACK ) );
-   text_layer_set_text_alignment( &curr_tempo_lay,
-                                  GTextAlignmentRight );
-   text_layer_set_text( &curr_tempo_lay, "100" );
-   layer_add_child( &find_tempo_win.layer, &curr_tempo_lay.layer );
-
-   text_layer_init( &curr_tempo_name_lay,
-                    GRect( 80, 42,
-                           30, 18 ) );
-   text_layer_set_font( &curr_tempo_name_lay,
-                        fonts_get_system_font( FONT_KEY_GOTHIC_18_BOLD ) );
-   text_layer_set_text_alignment( &curr_tempo_name_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &curr_tempo_name_lay, curr_tempo_name_str );
-   layer_add_child( &find_tempo_win.layer, &curr_tempo_name_lay.layer );
-
-   text_layer_init( &avg_tempo_lay,
-                    GRect( 10, 70,
-                           70, 30 ) );
-   text_layer_set_font( &avg_tempo_lay,
-                        fonts_get_system_font( FONT_KEY_BITHAM_30_BLACK ) );
-   text_layer_set_text_alignment( &avg_tempo_lay,
-                                  GTextAlignmentRight );
-   text_layer_set_text( &avg_tempo_lay, "100" );
-   layer_add_child( &find_tempo_win.layer, &avg_tempo_lay.layer );
-
-   text_layer_init( &avg_tempo_name_lay,
-                    GRect( 80, 82,
-                           30, 21 ) );
-   text_layer_set_font( &avg_tempo_name_lay,
-                        fonts_get_system_font( FONT_KEY_GOTHIC_18_BOLD ) );
-   text_layer_set_text_alignment( &avg_tempo_name_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &avg_tempo_name_lay, avg_tempo_name_str );
-   layer_add_child( &find_tempo_win.layer, &avg_tempo_name_lay.layer );
-
-   text_layer_init( &measuring_lay,
-                    GRect( 20, 110,
-                           65, 28 ) );
-   text_layer_set_font( &measuring_lay,
-                        fonts_get_system_font( FONT_KEY_GOTHIC_24_BOLD ) );
-   text_layer_set_text_alignment( &measuring_lay,
-                                  GTextAlignmentCenter );
-   text_layer_set_text( &measuring_lay, measuring_inactive_str );
-   layer_add_child( &find_tempo_win.layer, &measuring_lay.layer );
-
-   inverter_layer_init( &measuring_inverter_lay,
-                        GRect( 20, 114,
-                               65, 24 ) );
-   layer_add_child( &find_tempo_win.layer,
-                    (Layer*) &measuring_inverter_lay );
-   layer_set_hidden( (Layer*) &measuring_inverter_lay, true );
+   layout_build( &find_tempo_win.layer,
+                 find_tempo_layout,
+                 ARRAY_LENGTH(find_tempo_layout) );
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -600,9 +874,8 @@ void update_tempo_layer( uint8_t old_tempo,
                          uint8_t new_tempo )
 {
    if( old_tempo != new_tempo ) {
-      // NOTE: sprintf() isn't supported - get '_sbrk' errors.
-      snprintf( tempo_str, 4, "%d", new_tempo );
-      text_layer_set_text( &tempo_layer, tempo_str );
+      big_digits_set_value( &tempo_digits, new_tempo );
+      beat_engine_set_tempo( new_tempo );
    }
 }
 
@@ -633,226 +906,531 @@ void draw_visual_beat( Layer* lay, GContext* ctx )
    graphics_fill_circle( ctx, GPoint( 20, 20 ), 19 );
 }
 
-void handle_run_click( ClickRecognizerRef recognizer,
-                       Window* win );
+// Index on the shared grid of the beat engine's current grid point.
+uint32_t ensemble_beat;
+
+// Each beat is pulled at most this far toward the shared grid, so a
+// correction is spread over a few beats instead of being one lurch.
+#define ENSEMBLE_MAX_SLEW_MS (4)
+
+// Local time of beat k of the shared grid, beats being interval_q8
+// long, and its sub-ms remainder.
+uint32_t ensemble_beat_time( uint32_t k, uint32_t interval_q8, uint8_t* frac )
+{
+   uint64_t at = (uint64_t) k * interval_q8;
+
+   *frac = at & 0xFF;
+   return clock_sync_to_local( &ensemble_clock,
+                               ensemble_epoch + (uint32_t) ( at >> 8 ) );
+}
 
-void beat( void )
+// The beat engine's grid hook: called once the grid point has moved
+// on to the next beat.
+void ensemble_discipline( uint32_t* beat_time,
+                          uint8_t* beat_frac,
+                          uint32_t interval_q8 )
 {
-   if( should_stop_beating( num_beats++ ) ) {
-      // This stops beating.
-      handle_run_click( 0, 0 );
+   uint8_t frac;
+   int32_t err;
+
+   if( ! ensemble_locked || ! clock_sync_is_synced( &ensemble_clock ) ) {
+      return;
+   }
+   // Changing the tempo on this watch takes it out of the ensemble.
+   if( beat_engine_tempo() != ensemble_tempo ) {
+      ensemble_locked = false;
       return;
    }
 
-   // tempo = beats per min
-   // beat_interval = ms per beat
-   // 60,000 ms per min
-   //
-   // ms_per_min / tempo = ms/min / beats/min 
-   //                    = ms/beat
-   // 
-   layer_mark_dirty( &visual_beat_layer );
-   draw_beat = 1;
-   // This integer division will be off by up to 1ms.
-   beat_interval = 60000 / tempo;
-   beat_timer = app_timer_send_event( my_ctx, beat_interval, 0 );
-   clear_beat_timer = app_timer_send_event( my_ctx,
-                                            beat_interval / 2,
-                                            0 );
-   if( vibe_enabled ) {
-      vibes_enqueue_custom_pattern( vibe_pat );
+   ensemble_beat++;
+   err = (int32_t) (   ensemble_beat_time( ensemble_beat, interval_q8, &frac )
+                     - *beat_time );
+   if( err > ENSEMBLE_MAX_SLEW_MS ) {
+      err = ENSEMBLE_MAX_SLEW_MS;
+   } else if( err < - ENSEMBLE_MAX_SLEW_MS ) {
+      err = - ENSEMBLE_MAX_SLEW_MS;
+   } else {
+      *beat_frac = frac;
+   }
+   *beat_time += err;
+}
+
+// Under every window's handler, like the beat's, so it keeps going
+// whatever is up.
+bool handle_ensemble_timeout( AppContextRef app_ctx,
+                              AppTimerHandle handle,
+                              uint32_t cookie )
+{
+   uint8_t msg[CLOCK_SYNC_MAX_MESSAGE];
+   uint8_t len;
+
+   if( handle != ensemble_timer || ! ensemble_on ) {
+      return false;
+   }
+   len = clock_sync_poll( &ensemble_clock, hw_timer_get_time(), msg );
+   if( len > 0 ) {
+      phone_link_send( PHONE_LINK_SYNC_KEY, msg, len );
+   }
+   ensemble_timer = timer_stack_send_event( my_ctx,
+                                            CLOCK_SYNC_TIMEOUT_MS,
+                                            0,
+                                            sync_source );
+   return true;
+}
+
+// What the metronome does as the beat engine plays, whichever window
+// is up.
+void handle_beat_event( const beat_engine_info* info, void* ctx )
+{
+   switch( info->event ) {
+   case BEAT_ENGINE_STARTED:
+      text_layer_set_text( &run_layer, "stop" );
+      timer_trace_mark( &trace, hw_timer_get_time(), TIMER_TRACE_MARK_START );
+      if( metronome_visible && visual != VISUAL_FLASH ) {
+         pendulum_start( &beat_pendulum );
+      }
+      break;
+
+   case BEAT_ENGINE_BEAT:
+      if( press_to_beat_pending ) {
+         last_press_to_beat = hw_timer_get_time() - press_time;
+         latency_hist_add( &press_to_beat, last_press_to_beat );
+         press_to_beat_pending = false;
+      }
+
+      if( ! metronome_visible ) {
+         break;
+      }
+      if( visual == VISUAL_FLASH ) {
+         layer_mark_dirty( &visual_beat_layer );
+         draw_beat = 1;
+         clear_beat_timer = timer_stack_send_event( my_ctx,
+                                                    info->interval / 2,
+                                                    0,
+                                                    flash_source );
+      } else {
+         pendulum_beat( &beat_pendulum, info->time, info->interval );
+      }
+      break;
+
+   case BEAT_ENGINE_SECTION:
+      tempo = beat_engine_tempo();
+      groove = *beat_engine_groove();
+      big_digits_set_value( &tempo_digits, tempo );
+      break;
+
+   case BEAT_ENGINE_STOPPED:
+      text_layer_set_text( &run_layer, "start" );
+      pendulum_stop( &beat_pendulum );
+      timer_trace_mark( &trace, hw_timer_get_time(), TIMER_TRACE_MARK_STOP );
+      break;
    }
 }
 
 void handle_run_click( ClickRecognizerRef recognizer,
                        Window* win )
 {
-   running = ! running;
-   text_layer_set_text( &run_layer, ( running ? "stop" : "start" ) );
-   
-   if( running ) {
-      num_beats = 0;
-      beat();
+   if( ! beat_engine_running() ) {
+      // Starting by hand leaves the ensemble until the phone sends a
+      // new grid.
+      ensemble_locked = false;
+      beat_engine_start();
+   } else {
+      beat_engine_stop();
+   }
+}
+
+// Jump onto the shared grid: the first beat of it that's still to
+// come.
+void ensemble_join( void )
+{
+   uint32_t interval_q8;
+   uint32_t now_shared;
+   int32_t elapsed;
+   uint32_t k = 0;
+   uint32_t beat_time;
+   uint8_t beat_frac;
+
+   if( ensemble_tempo < min_tempo || ensemble_tempo > max_tempo ) {
+      return;
+   }
+   tempo = ensemble_tempo;
+   big_digits_set_value( &tempo_digits, tempo );
+   beat_engine_set_tempo( tempo );
+   interval_q8 = groove_interval_q8( tempo );
+
+   now_shared = clock_sync_to_shared( &ensemble_clock,
+                                      hw_timer_get_time() );
+   elapsed = (int32_t) ( now_shared - ensemble_epoch );
+   if( elapsed > 0 ) {
+      k = ( ( (uint64_t) elapsed << 8 ) + interval_q8 - 1 ) / interval_q8;
+   }
+   ensemble_beat = k;
+   beat_time = ensemble_beat_time( k, interval_q8, &beat_frac );
+
+   // The new tempo goes in now rather than on the next beat.
+   beat_engine_start_at( beat_time, beat_frac );
+}
+
+uint16_t handle_preset_message( const uint8_t* msg,
+                                uint16_t len,
+                                uint8_t* reply )
+{
+   return preset_proto_handle( &presets, msg, len, reply );
+}
+
+uint16_t handle_trace_message( const uint8_t* msg,
+                               uint16_t len,
+                               uint8_t* reply )
+{
+   return timer_trace_handle( &trace, msg, len, reply );
+}
+
+uint16_t handle_sync_message( const uint8_t* msg,
+                              uint16_t len,
+                              uint8_t* reply )
+{
+   uint32_t now = hw_timer_get_time();
+   bool was_synced = clock_sync_is_synced( &ensemble_clock );
+   uint16_t reply_len = 0;
+
+   if( ! ensemble_on ) {
+      return 0;
+   }
+
+   if( clock_sync_parse_epoch( msg, len, &ensemble_epoch,
+                               &ensemble_tempo ) ) {
+      if( ensemble_tempo == 0 ) {
+         ensemble_locked = false;
+         beat_engine_stop();
+         return 0;
+      }
+      ensemble_locked = true;
+   } else {
+      reply_len = clock_sync_handle_response( &ensemble_clock,
+                                              msg, len, now, reply );
+      if( clock_sync_is_synced( &ensemble_clock ) != was_synced ) {
+         update_menu( &menu_win );
+      }
+      // A grid that came in while we were still syncing is only
+      // joined now.
+      if( was_synced || ! ensemble_locked ) {
+         return reply_len;
+      }
+   }
+
+   if( clock_sync_is_synced( &ensemble_clock ) ) {
+      ensemble_join();
+   }
+   return reply_len;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Stress test: the real beat and pendulum at the storm tempo, with
+// stand-ins for the spinner and tap timeout piled on top.  What the
+// user had set is put back afterwards.
+
+uint8_t stress_saved_tempo;
+groove_template stress_saved_groove;
+uint8_t stress_saved_visual;
+bool stress_spin_up;
+
+// What a spinner fast-repeat costs: a new number, redrawn.
+void stress_spin_work( void )
+{
+   stress_spin_up = ! stress_spin_up;
+   big_digits_set_value( &tempo_digits,
+                         stress_spin_up ? EVENT_STORM_TEMPO
+                                        : EVENT_STORM_TEMPO - 1 );
+}
+
+// What the tap timeout costs: both tempos formatted and set.
+void stress_tap_work( void )
+{
+   snprintf( curr_tempo_str, 4, "%d", tempo );
+   text_layer_set_text( &curr_tempo_lay, curr_tempo_str );
+   snprintf( avg_tempo_str, 4, "%d", tempo );
+   text_layer_set_text( &avg_tempo_lay, avg_tempo_str );
+}
+
+void stress_restore( void )
+{
+   beat_engine_stop();
+   tempo = stress_saved_tempo;
+   big_digits_set_value( &tempo_digits, tempo );
+   beat_engine_set_tempo( tempo );
+   groove = stress_saved_groove;
+   beat_engine_set_groove( &groove );
+   visual = stress_saved_visual;
+   menu_items[VISUAL_INDEX].subtitle = visual_names[visual];
+   apply_visual();
+}
+
+void stress_done( void )
+{
+   stress_restore();
+   diag_win_open( DIAG_PAGE_LATENCY );
+}
+
+// Start a trace, or end one early.  It's taken at the tempo and
+// groove of the moment, which is what the replay will play.
+void trace_selected( int index, void* context )
+{
+   if( trace.recording ) {
+      timer_trace_stop( &trace );
    } else {
-      app_timer_cancel_event( my_ctx, beat_timer );
+      timer_trace_start( &trace,
+                         hw_timer_get_time(),
+                         tempo,
+                         groove.subdivisions,
+                         trace_sources,
+                         ARRAY_LENGTH(trace_sources) );
+      timer_stack_set_trace( &trace );
+   }
+   menu_items[index].subtitle = get_str_for_trace();
+   layer_mark_dirty( (Layer*) &menu_lay );
+}
+
+void stress_selected( int index, void* context )
+{
+   if( stress_running() ) {
+      return;
    }
+
+   stress_saved_tempo = tempo;
+   stress_saved_groove = groove;
+   stress_saved_visual = visual;
+
+   // Stopped first: stopping can take a song back to its first
+   // section's tempo.
+   beat_engine_stop();
+
+   tempo = EVENT_STORM_TEMPO;
+   big_digits_set_value( &tempo_digits, tempo );
+   beat_engine_set_tempo( tempo );
+   groove.subdivisions = EVENT_STORM_SUBDIVISIONS;
+   groove_template_clamp( &groove );
+   beat_engine_set_groove( &groove );
+   visual = VISUAL_PENDULUM;
+   apply_visual();
+
+   // Back to the metronome window, whose timer handler carries the
+   // storm.
+   window_stack_pop( true );
+
+   handle_run_click( 0, 0 );
+   stress_start();
 }
 
 bool handle_beat_timeout( AppContextRef app_ctx,
                           AppTimerHandle handle,
                           uint32_t cookie )
 {
-   if( handle == beat_timer ) {
-      beat();
-   } else if( handle == clear_beat_timer ) {
+   if( handle == clear_beat_timer ) {
       draw_beat = 0;
       layer_mark_dirty( &visual_beat_layer );
-   } else {
-      return false;
+   } else if( ! stress_handle_timeout( handle ) ) {
+      return pendulum_handle_timeout( &beat_pendulum, handle );
    }
 
    return true;
 }
 
-void handle_double_click( ClickRecognizerRef recognizer,
-                          Window* win )
+void find_tempo_selected( int index, void* context )
 {
    window_stack_push( &find_tempo_win, true );
 }
 
+// What the select press still going on did, so a long press into the
+// menu can take it back: started the beat, the ensemble having been
+// locked or not before, or is to stop it when released.
+bool press_started;
+bool press_was_locked;
+bool press_stop_pending;
+
+void handle_select_down( ClickRecognizerRef recognizer, void* ctx )
+{
+   press_time = hw_timer_get_time();
+   timer_trace_button( &trace, press_time, BUTTON_ID_SELECT, true );
+
+   if( input != INPUT_PRESS ) {
+      return;
+   }
+   if( beat_engine_running() ) {
+      // Stopping waits for the release, so a long press leaves the
+      // beat as it was - the song where it's got to, and still locked
+      // to the ensemble.
+      press_stop_pending = true;
+   } else {
+      press_was_locked = ensemble_locked;
+      press_to_beat_pending = true;
+      handle_run_click( recognizer, NULL );
+      press_started = true;
+   }
+}
+
+void handle_select_up( ClickRecognizerRef recognizer, void* ctx )
+{
+   timer_trace_button( &trace, hw_timer_get_time(), BUTTON_ID_SELECT, false );
+   if( press_stop_pending ) {
+      beat_engine_stop();
+   }
+   press_started = false;
+   press_stop_pending = false;
+}
+
+void handle_select_click( ClickRecognizerRef recognizer, Window* win )
+{
+   press_to_beat_pending = ! beat_engine_running();
+   handle_run_click( recognizer, win );
+}
+
+void handle_select_long( ClickRecognizerRef recognizer, Window* win )
+{
+   // This press was for the menu, not for start/stop.
+   if( press_started ) {
+      press_to_beat_pending = false;
+      beat_engine_cancel();
+      ensemble_locked = press_was_locked;
+   }
+   press_started = false;
+   press_stop_pending = false;
+   switch_to_menu( recognizer, win );
+}
+
 void config_click_provider( ClickConfig** config,
                             Window* window )
 {
-   config[BUTTON_ID_SELECT]->click.handler =
-      (ClickHandler) &handle_run_click;
+   // The press is timestamped either way, so the two modes can be
+   // compared.
+   config[BUTTON_ID_SELECT]->raw.down_handler =
+      (ClickHandler) &handle_select_down;
+   config[BUTTON_ID_SELECT]->raw.up_handler =
+      (ClickHandler) &handle_select_up;
+
+   if( input == INPUT_CLICK ) {
+      config[BUTTON_ID_SELECT]->click.handler =
+         (ClickHandler) &handle_select_click;
+   }
+
    config[BUTTON_ID_SELECT]->long_click.handler =
-      (ClickHandler) &switch_to_menu;
+      (ClickHandler) &handle_select_long;
    config[BUTTON_ID_SELECT]->long_click.delay_ms = 500;
-
-   config[BUTTON_ID_SELECT]->multi_click.handler =
-      (ClickHandler) &handle_double_click;
-   config[BUTTON_ID_SELECT]->multi_click.min = 2;
-   config[BUTTON_ID_SELECT]->multi_click.min = 2;
-   config[BUTTON_ID_SELECT]->multi_click.last_click_only = true;
-   config[BUTTON_ID_SELECT]->multi_click.timeout = 200;
 }
 
 void metronome_win_appear( Window* win )
 {
    spinner_activate();
    timer_stack_push( handle_beat_timeout );
+
+   metronome_visible = true;
+   if( beat_engine_running() && visual != VISUAL_FLASH ) {
+      pendulum_start( &beat_pendulum );
+   }
 }
 
 void metronome_win_disappear( Window* win )
 {
+   // The storm's timers are handled from here; cut it short.
+   if( stress_running() ) {
+      stress_stop();
+      stress_restore();
+   }
+
+   // The beat carries on; only the drawing of it stops, since the
+   // flash and pendulum timers are handled here.
+   metronome_visible = false;
+   pendulum_stop( &beat_pendulum );
+   timer_stack_cancel_event( my_ctx, clear_beat_timer );
+   draw_beat = 0;
+
    timer_stack_pop();
    spinner_deactivate( &tempo_spin );
 }
 
+// GRect( xorg, yorg, width, height )
+//    xorg is measured from left
+//    yorg is measured from top
+//    the box is width x hight, with its top-left corner at
+//    (xorg,yorg).
+//
+// Pebble is 144 x 168 (width x height).  In a normal app, with the
+// bar on top (time, battery status), you have 144 x 141 available.
+// The 21-pix font needs another 4 pix for lowercase descenders.
+
+// The tempo digits are 3 cells, centered in height but a bit over to
+// the left.  The digits come from the big_digits atlas, so their size
+// is known exactly - no trial and error with proportional fonts.
+#define TEMPO_XORG (10)
+#define TEMPO_YORG ( ( LAYOUT_SCREEN_HEIGHT - BIG_DIGIT_HEIGHT ) / 2 )
+
+const layout_item metronome_layout[] = {
+   // "bpm", under the tempo.
+   { LAYOUT_TEXT, 0, GTextAlignmentCenter,
+     LAYOUT_RECT( TEMPO_XORG, TEMPO_YORG + BIG_DIGIT_HEIGHT + 2,
+                  BIG_DIGITS_WIDTH(3), BIG_DIGIT_HEIGHT ),
+     FONT_KEY_ROBOTO_CONDENSED_21, bpm_str, &bpm_layer },
+   // Up button, far right on top.
+   { LAYOUT_TEXT, 0, GTextAlignmentRight,
+     LAYOUT_RECT( LAYOUT_SCREEN_WIDTH - 20, 0, 20, 21 + 4 ),
+     FONT_KEY_ROBOTO_CONDENSED_21, "up", &up_layer },
+   // Down button, far right on bottom.
+   { LAYOUT_TEXT, 0, GTextAlignmentRight,
+     LAYOUT_RECT( LAYOUT_SCREEN_WIDTH - 46, LAYOUT_SCREEN_HEIGHT - 21,
+                  46, 21 ),
+     FONT_KEY_ROBOTO_CONDENSED_21, "down", &down_layer },
+   // Run button, far right in middle.
+   { LAYOUT_TEXT, 0, GTextAlignmentRight,
+     LAYOUT_RECT( LAYOUT_SCREEN_WIDTH - 40,
+                  ( LAYOUT_SCREEN_HEIGHT - ( 21 + 4 ) ) / 2,
+                  40, 21 + 4 ),
+     FONT_KEY_ROBOTO_CONDENSED_21, "start", &run_layer },
+};
+
 void metronome_win_lay_out( void )
 {
-  // So, text_align(..., GRect) works lke this:
-  //
-  // GRect( xorg, yorg, width, height )
-  //    xorg is measured from left
-  //    yorg is measured from top
-  //    the box is width x hight, with its top-left corner at
-  //    (xorg,yorg).
-
-  // // Pebble is 144 x 168 (width x height).  In a normal app, with
-  // // the bar on top (time, battery status), you have 144 x 131
-  // // available for usage.
-  // Font is displayed on top of the rect.
-
-  // 144 x 131 available.
-  // font is 21-pix high
-
-  // For a 21-pix font.
-  int font_height = 21;
-  int font_descender_height = 4;
-  int screen_width = 144;
-  int screen_height = 141;
-
-  // Tempo layer.
-
-  font_height = 42;
-  // This number was determined empirically.  There are no font
-  // metrics available, so I have to just trial and error to get the
-  // right widths for proportional fonts.
-  int box_w = 80;
-  int box_h = font_height;
-
-  // We want it centered in height but a bit over to the left.
-  int xorg = 10;
-  int yorg = ( screen_height - box_h ) / 2;
-
-  // This displays X centered in a 30x30 box in the top-left corner.
-  // This X is 12 pix wide and 21 pix high.
-  text_layer_init( &tempo_layer, GRect( xorg, yorg, box_w, box_h ) );
-  text_layer_set_text_alignment( &tempo_layer,
-                                 GTextAlignmentCenter );
-  snprintf( tempo_str, 4, "%d", 96 );
-  text_layer_set_text( &tempo_layer, tempo_str );
-  text_layer_set_font( &tempo_layer,
-                       fonts_get_system_font( FONT_KEY_BITHAM_42_BOLD ) );
-
-  text_layer_init( &bpm_layer, GRect( xorg, yorg + font_height,
-                                      box_w, box_h ) );
-  text_layer_set_text_alignment( &bpm_layer,
-                                 GTextAlignmentCenter );
-  text_layer_set_font( &bpm_layer,
-                       fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-  text_layer_set_text( &bpm_layer, bpm_str );
-  
-
-  // Up button layer.
-
-  font_height = 21;
-  box_w = 20;
-  box_h = font_height + font_descender_height;
-  // extra space for lowercase descenders.
-
-  // To put up against far right on top:
-  xorg = screen_width - box_w;
-  yorg = 0;
-
-  text_layer_init( &up_layer, GRect( xorg, yorg, box_w, box_h ) );
-  text_layer_set_text_alignment( &up_layer,
-                                 GTextAlignmentRight );
-  text_layer_set_text( &up_layer, "up" );
-  text_layer_set_font(
-     &up_layer,
-     fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-
-  // Down button layer.
-
-  box_w = 46;
-  box_h = font_height;
+  big_digits_init( &tempo_digits,
+                   &window.layer,
+                   GPoint( TEMPO_XORG, TEMPO_YORG ),
+                   3 );
+  big_digits_set_value( &tempo_digits, tempo );
 
-  // To put up against far right on bottom:
-  xorg = screen_width - box_w;
-  yorg = screen_height - box_h;
-
-  text_layer_init( &down_layer, GRect( xorg, yorg, box_w, box_h ) );
-  text_layer_set_text_alignment( &down_layer,
-                                 GTextAlignmentRight );
-  text_layer_set_text( &down_layer, "down" );
-  text_layer_set_font(
-     &down_layer,
-     fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
-
-  // Run button layer.
-
-  box_w = 40;
-  box_h = font_height + font_descender_height;
-
-  // To put up against far right in middle.
-  xorg = screen_width - box_w;
-  yorg = ( screen_height - box_h ) / 2;
-
-  text_layer_init( &run_layer, GRect( xorg, yorg, box_w, box_h ) );
-  text_layer_set_text_alignment( &run_layer,
-                                 GTextAlignmentRight );
-  text_layer_set_text( &run_layer, "start" );
-  text_layer_set_font(
-     &run_layer,
-     fonts_get_system_font( FONT_KEY_ROBOTO_CONDENSED_21 ) );
+  layout_build( &window.layer,
+                metronome_layout,
+                ARRAY_LENGTH(metronome_layout) );
 
   layer_init( &visual_beat_layer, GRect( 0, 0, 40, 40 ) );
   visual_beat_layer.update_proc = (LayerUpdateProc) &draw_visual_beat;
-
-  layer_add_child( &window.layer, &tempo_layer.layer );
-  layer_add_child( &window.layer, &bpm_layer.layer );
-  layer_add_child( &window.layer, &up_layer.layer );
-  layer_add_child( &window.layer, &down_layer.layer );
-  layer_add_child( &window.layer, &run_layer.layer );
   layer_add_child( &window.layer, &visual_beat_layer );
+
+  // The pendulum swings in the space above the tempo, clear of the
+  // "up" label.
+  pendulum_init( &beat_pendulum,
+                 &window.layer,
+                 GRect( 0, 0, LAYOUT_SCREEN_WIDTH - 34, 46 ),
+                 my_ctx );
 }
 
 void handle_init(AppContextRef ctx)
 {
+   // Before anything else, so it paints as much stack as it can.
+   mem_diag_paint_stack();
+
    my_ctx = ctx;
 
+   resource_init_current_app( &VERSION );
+
+   big_digits_init_once();
+
+   // The beat's and the ensemble's timer handlers go on the timer
+   // stack first, under every window's, and stay there.  A window and
+   // its spinner on top make TIMER_STACK_MAX_DEPTH.
+   timer_stack_init_once();
+   beat_engine_init_once( my_ctx, vibe_shapes );
+   beat_engine_subscribe( &handle_beat_event, NULL );
+   beat_engine_set_grid_hook( &ensemble_discipline );
+   timer_stack_push( &handle_ensemble_timeout );
+
    // Metronome window.
 
   window_init(&window, "Metronome Win");
@@ -865,6 +1443,9 @@ void handle_init(AppContextRef ctx)
                 (ClickHandler) tempo_down,
                 (ClickConfigProvider) &config_click_provider,
                 my_ctx );
+  input = INPUT_PRESS;
+  tempo_spin.press_down = true;
+  latency_hist_reset( &press_to_beat );
 
   metronome_win_lay_out();
 
@@ -875,7 +1456,9 @@ void handle_init(AppContextRef ctx)
   window_init(&menu_win, "Menu Win");
   
   simple_menu_layer_init( &menu_lay,
-                          GRect( 0, 0, 144, 141 ),
+                          GRect( 0, 0,
+                                 LAYOUT_SCREEN_WIDTH,
+                                 LAYOUT_SCREEN_HEIGHT ),
                           &menu_win,
                           menu_sect,
                           ARRAY_LENGTH(menu_sect),
@@ -883,28 +1466,66 @@ void handle_init(AppContextRef ctx)
   menu_win.window_handlers.appear = (WindowHandler) &update_menu;
   layer_add_child( &menu_win.layer, (Layer*) &menu_lay );
 
-  vibe_dur_win_init();
+  stop_after = INIT_STOP_AFTER;
+  vibe_dur = INIT_VIBE_DUR;
+  groove_template_init( &groove );
+  beat_engine_set_tempo( tempo );
+  beat_engine_set_groove( &groove );
+  beat_engine_set_vibe( vibe_enabled, vibe_dur );
+  beat_engine_set_stop_after( stop_after );
+
+  num_editor_init_once( my_ctx );
+
+  library_init_once();
+  library_win_init_once( &load_song, &presets, &load_preset );
+
+  preset_store_init( &presets, &apply_pushed_settings );
+  phone_link_init_once();
+  phone_link_set_handler( PHONE_LINK_PRESET_KEY, &handle_preset_message );
+  phone_link_set_handler( PHONE_LINK_SYNC_KEY, &handle_sync_message );
+  phone_link_set_handler( PHONE_LINK_TRACE_KEY, &handle_trace_message );
 
-  stop_after_win_init();
+  diag_win_init_once( &fill_diagnostics );
+  stress_init_once( my_ctx, &stress_spin_work, &stress_tap_work,
+                    &stress_done );
 
   find_tempo_win_init();
 
-  timer_stack_init_once();
+  // The beat grid, tap tempo and everything else that needs real
+  // time use TIM5.  PebbleOS 1.12.1 doesn't provide any kind of
+  // high-resolution timer/counter facility, so we have no accurate
+  // way of measuring time otherwise.
+  //
+  // I tried setting up a timer to run at 10ms and just count
+  // ticks... but this was incredibly inaccurate and noisy.  Using
+  // TIM5, a 32-bit counter, is much better.
+  hw_timer_init( 1000 );
 
   spinner_init_once();
 }
 
+void handle_deinit(AppContextRef ctx)
+{
+  hw_timer_deinit();
+}
+
 
 void pbl_main(void *params) {
   PebbleAppHandlers handlers = {
      .init_handler = &handle_init,
-     .timer_handler = &timer_stack_handle_timeout
+     .deinit_handler = &handle_deinit,
+     .timer_handler = &timer_stack_handle_timeout,
      // .timer_handler = &handle_timeout,
+     .messaging_info = {
+        .buffer_sizes = {
+           .inbound = PHONE_LINK_INBOUND_SIZE,
+           .outbound = PHONE_LINK_OUTBOUND_SIZE
+        }
+     }
   };
   tempo = 96;
   min_tempo = 48;
   max_tempo = 208;
-  running = 0;
   vibe_enabled = 1;
   app_event_loop(params, &handlers);
 }
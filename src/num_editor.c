@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////
+//
+// num_editor.c
+//
+// The shared spinner-driven number editor window.
+//
+// See num_editor.h for more information.
+//
+
+#include "num_editor.h"
+#include "spinner.h"
+#include "big_digits.h"
+#include "layout.h"
+
+static Window editor_win;
+static spinner editor_spin;
+
+static TextLayer title_lay;
+static InverterLayer title_inverter_lay;
+static TextLayer units_lay;
+static big_digits value_digits;
+
+static const layout_item editor_layout[] = {
+   LAYOUT_TITLE_BAR( &title_lay, &title_inverter_lay, NULL ),
+   { LAYOUT_TEXT, 0, GTextAlignmentCenter,
+     LAYOUT_RECT( 0, 92, LAYOUT_SCREEN_WIDTH, 25 ),
+     FONT_KEY_ROBOTO_CONDENSED_21, NULL, &units_lay },
+};
+
+static const num_editor_field* fields;
+static uint8_t num_fields;
+static uint8_t field_index;
+static num_editor_changed on_change;
+
+static int16_t get_value( const num_editor_field* field )
+{
+   return field->is_signed ? *(int8_t*) field->value : *field->value;
+}
+
+static void update_field( void )
+{
+   const num_editor_field* field = &fields[field_index];
+   int16_t value = get_value( field );
+
+   text_layer_set_text( &title_lay, field->title );
+   if( value == 0 && field->zero_str ) {
+      big_digits_set_blank( &value_digits );
+      text_layer_set_text( &units_lay, field->zero_str );
+   } else {
+      big_digits_set_value( &value_digits, value );
+      text_layer_set_text( &units_lay, field->units );
+   }
+}
+
+static void change_value( int16_t delta )
+{
+   const num_editor_field* field = &fields[field_index];
+   int16_t value = get_value( field ) + delta;
+
+   if( value < field->min || value > field->max ) {
+      return;
+   }
+
+   *field->value = (uint8_t) value;
+   update_field();
+   if( on_change ) {
+      (*on_change)();
+   }
+}
+
+static void editor_up( ClickRecognizerRef recognizer,
+                       void* context )
+{
+   change_value( 1 );
+}
+
+static void editor_down( ClickRecognizerRef recognizer,
+                         void* context )
+{
+   change_value( -1 );
+}
+
+static void editor_next_field( ClickRecognizerRef recognizer,
+                               void* context )
+{
+   if( num_fields < 2 ) {
+      return;
+   }
+
+   do {
+      if( ++field_index >= num_fields ) {
+         field_index = 0;
+      }
+   } while(    fields[field_index].visible
+            && ! (*fields[field_index].visible)() );
+
+   update_field();
+}
+
+static void editor_click_config( ClickConfig** config,
+                                 void* context )
+{
+   config[BUTTON_ID_SELECT]->click.handler =
+      (ClickHandler) &editor_next_field;
+}
+
+static void editor_win_appear( Window* win )
+{
+   update_field();
+   spinner_activate();
+}
+
+static void editor_win_disappear( Window* win )
+{
+   spinner_deactivate( &editor_spin );
+}
+
+void num_editor_init_once( AppContextRef ctx )
+{
+   window_init( &editor_win, "Editor" );
+   editor_win.window_handlers.appear =
+      (WindowHandler) &editor_win_appear;
+   editor_win.window_handlers.disappear =
+      (WindowHandler) &editor_win_disappear;
+
+   spinner_init( &editor_spin,
+                 &editor_win,
+                 editor_up,
+                 editor_down,
+                 (ClickConfigProvider) &editor_click_config,
+                 ctx );
+
+   layout_build( &editor_win.layer,
+                 editor_layout,
+                 ARRAY_LENGTH(editor_layout) );
+
+   big_digits_init( &value_digits,
+                    &editor_win.layer,
+                    GPoint( ( LAYOUT_SCREEN_WIDTH
+                              - BIG_DIGITS_WIDTH(BIG_DIGITS_MAX_DIGITS) ) / 2,
+                            50 ),
+                    BIG_DIGITS_MAX_DIGITS );
+}
+
+void num_editor_open( const num_editor_field* new_fields,
+                      uint8_t new_num_fields,
+                      num_editor_changed new_on_change )
+{
+   fields = new_fields;
+   num_fields = new_num_fields;
+   field_index = 0;
+   on_change = new_on_change;
+
+   window_stack_push( &editor_win, true );
+}
@@ -0,0 +1,54 @@
+#ifndef NUM_EDITOR_H
+#define NUM_EDITOR_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// num_editor.h
+//
+// One window that edits any small number with the spinner.
+//
+// Every spinner-edited setting used to have its own copy of the same
+// window: title bar, a big number, a units line and a spinner.  Now a
+// setting is just a const num_editor_field describing it, and
+// num_editor_open() points the one shared window at it.
+//
+// You can also hand over several fields at once; select then steps
+// through them, skipping any whose visible() says they don't apply
+// right now.
+//
+// To use this:
+//
+// 1.  Call num_editor_init_once() in your app init function, after
+//     big_digits_init_once().
+//
+// 2.  Call num_editor_open() to push the editor window.
+
+typedef struct {
+   const char* title;
+   const char* units;
+   // If non-NULL, a value of 0 is shown as this text instead.
+   const char* zero_str;
+
+   // The value being edited.  8 bits, signed or unsigned.
+   uint8_t* value;
+   bool is_signed;
+   int16_t min;
+   int16_t max;
+
+   // NULL means always visible.
+   bool (* visible)( void );
+} num_editor_field;
+
+// Called after every change of value.
+typedef void (* num_editor_changed)( void );
+
+void num_editor_init_once( AppContextRef ctx );
+
+void num_editor_open( const num_editor_field* fields,
+                      uint8_t num_fields,
+                      num_editor_changed on_change );
+
+#endif
@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////
+//
+// onset_detector.c
+//
+// Fixed-point high-pass / envelope / adaptive threshold onset
+// detection.
+//
+// See onset_detector.h for more information.
+//
+
+#include "onset_detector.h"
+
+// High-pass pole, Q15.  0.875 puts the corner at a couple of Hz for
+// the sample rates we care about (25-100Hz).
+#define HP_POLE_Q15 (28672)
+
+// Leaky integrator shifts: envelope follows in ~8 samples, background
+// in ~128.
+#define ENVELOPE_SHIFT (3)
+#define BACKGROUND_SHIFT (7)
+
+// Squared high-pass output is scaled down so it fits comfortably in
+// 32 bits.
+#define ENERGY_SHIFT (8)
+
+static int32_t abs32( int32_t v )
+{
+   return ( v < 0 ) ? -v : v;
+}
+
+void onset_detector_init( onset_detector* det,
+                          uint16_t sample_rate_hz,
+                          onset_callback callback,
+                          void* context )
+{
+   det->threshold_ratio_q4 = ONSET_DEFAULT_THRESHOLD_RATIO_Q4;
+   det->min_energy = ONSET_DEFAULT_MIN_ENERGY;
+   det->refractory_ms = ONSET_DEFAULT_REFRACTORY_MS;
+
+   det->sample_period_q8 = ( 1000 << 8 ) / sample_rate_hz;
+   det->callback = callback;
+   det->context = context;
+
+   onset_detector_reset( det );
+}
+
+void onset_detector_reset( onset_detector* det )
+{
+   det->primed = false;
+   det->prev_mag = 0;
+   det->hp = 0;
+   det->envelope = 0;
+   det->background = 0;
+   det->armed = true;
+   det->have_onset = false;
+   det->last_onset_time = 0;
+}
+
+uint16_t onset_detector_process( onset_detector* det,
+                                 const onset_sample* samples,
+                                 uint16_t num_samples,
+                                 uint32_t first_sample_time )
+{
+   if( num_samples > ONSET_MAX_BATCH ) {
+      num_samples = ONSET_MAX_BATCH;
+   }
+
+   for( uint16_t i = 0; i < num_samples; i++ ) {
+      const onset_sample* s = &samples[i];
+      int32_t mag = abs32( s->x ) + abs32( s->y ) + abs32( s->z );
+      uint32_t hp_mag;
+      uint32_t energy;
+      uint32_t threshold;
+      uint32_t now;
+
+      // The first sample after a reset only primes the filter.
+      // Otherwise gravity's ~1 g arrives as a step from 0 and is
+      // reported as an onset.
+      if( ! det->primed ) {
+         det->prev_mag = mag;
+         det->primed = true;
+      }
+
+      // 1. High-pass.
+      det->hp = (int32_t)
+         ( ( (int64_t) HP_POLE_Q15 * ( det->hp + mag - det->prev_mag ) )
+           >> 15 );
+      det->prev_mag = mag;
+
+      // 2. Energy envelope.  Clamp first so the square can't
+      // overflow 32 bits on a really hard hit.
+      hp_mag = (uint32_t) abs32( det->hp );
+      if( hp_mag > 0xFFFF ) {
+         hp_mag = 0xFFFF;
+      }
+      energy = ( hp_mag * hp_mag ) >> ENERGY_SHIFT;
+      if( energy > det->envelope ) {
+         det->envelope += ( energy - det->envelope ) >> ENVELOPE_SHIFT;
+      } else {
+         det->envelope -= ( det->envelope - energy ) >> ENVELOPE_SHIFT;
+      }
+
+      // 3. Adaptive threshold.
+      if( det->envelope > det->background ) {
+         det->background +=
+            ( det->envelope - det->background ) >> BACKGROUND_SHIFT;
+      } else {
+         det->background -=
+            ( det->background - det->envelope ) >> BACKGROUND_SHIFT;
+      }
+      threshold = ( det->background * det->threshold_ratio_q4 ) >> 4;
+      if( threshold < det->min_energy ) {
+         threshold = det->min_energy;
+      }
+
+      if( det->envelope <= threshold ) {
+         // Fell back below threshold - the next rise is a new onset.
+         det->armed = true;
+         continue;
+      }
+
+      if( ! det->armed ) {
+         continue;
+      }
+
+      now = first_sample_time + ( ( i * det->sample_period_q8 ) >> 8 );
+      if(    det->have_onset
+          && now - det->last_onset_time < det->refractory_ms ) {
+         continue;
+      }
+
+      det->armed = false;
+      det->have_onset = true;
+      det->last_onset_time = now;
+      if( det->callback ) {
+         (*det->callback)( now, det->context );
+      }
+   }
+
+   return num_samples;
+}
@@ -0,0 +1,95 @@
+#ifndef ONSET_DETECTOR_H
+#define ONSET_DETECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// onset_detector.h
+//
+// A streaming, fixed-point onset detector for accelerometer samples.
+// It lets the Find Tempo estimator pick up beats from the wrist
+// (foot tapping, strumming, a bow stroke) instead of from the down
+// button.
+//
+// Each sample goes through three stages, all in integer math:
+//
+// 1.  High-pass.  The |x|+|y|+|z| magnitude is run through a one-pole
+//     high-pass filter so gravity and slow arm movement drop out.
+//
+// 2.  Energy envelope.  The squared high-pass output is smoothed by a
+//     fast leaky integrator.
+//
+// 3.  Adaptive threshold.  A much slower integrator tracks the
+//     background energy.  An onset is reported when the envelope
+//     rises above a multiple of the background, and the detector then
+//     stays quiet for a refractory period so one hit isn't reported
+//     twice.
+//
+// Samples are handed over in batches.  A single call never looks at
+// more than ONSET_MAX_BATCH samples, so the CPU spent per call is
+// bounded and a beat timer queued behind it is never held up for
+// long.  If you have more samples than that, call again (from the
+// next event) with the remainder - the return value says how many
+// samples were consumed.
+//
+// Every onset found is passed to the onset callback with its
+// timestamp in ms, ready for tempo_estimator_add_onset().
+
+#define ONSET_MAX_BATCH (32)
+
+typedef struct {
+   int16_t x;
+   int16_t y;
+   int16_t z;
+} onset_sample;
+
+typedef void (* onset_callback)( uint32_t onset_time, void* context );
+
+typedef struct {
+   // You can change stuff here (after onset_detector_init()).
+
+   // Envelope must exceed background * threshold_ratio_q4 / 16.
+   uint16_t threshold_ratio_q4;
+   // ... and must exceed this absolute energy, so noise on a still
+   // wrist doesn't count.
+   uint32_t min_energy;
+   // No second onset within this many ms of the first.
+   uint16_t refractory_ms;
+
+   // Don't touch!!
+   uint32_t sample_period_q8;   // ms per sample, Q24.8
+   bool primed;                 // prev_mag holds a real sample
+   int32_t prev_mag;
+   int32_t hp;
+   uint32_t envelope;
+   uint32_t background;
+   bool armed;
+   bool have_onset;
+   uint32_t last_onset_time;
+
+   onset_callback callback;
+   void* context;
+} onset_detector;
+
+#define ONSET_DEFAULT_THRESHOLD_RATIO_Q4 (48)  // 3x background
+#define ONSET_DEFAULT_MIN_ENERGY (2000)
+#define ONSET_DEFAULT_REFRACTORY_MS (200)      // caps out near 300 bpm
+
+void onset_detector_init( onset_detector* det,
+                          uint16_t sample_rate_hz,
+                          onset_callback callback,
+                          void* context );
+
+// Forget the filter history, e.g. when measuring restarts.
+void onset_detector_reset( onset_detector* det );
+
+// Feed up to ONSET_MAX_BATCH samples, the first of which was taken
+// at first_sample_time (ms).  Returns the number of samples consumed.
+uint16_t onset_detector_process( onset_detector* det,
+                                 const onset_sample* samples,
+                                 uint16_t num_samples,
+                                 uint32_t first_sample_time );
+
+#endif
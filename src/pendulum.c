@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////
+//
+// pendulum.c
+//
+// Swinging pendulum / sweeping bar beat visual with dirty-box
+// redraws.
+//
+// See pendulum.h for more information.
+//
+
+#include "pendulum.h"
+#include "hw_timer.h"
+#include "timer_stack.h"
+#include "event_storm.h"
+
+// Frame timers, as timer_stack measures them.
+static const char* const frame_source = event_storm_frame_name;
+
+static GRect to_grect( pendulum_box b )
+{
+   return GRect( b.x, b.y, b.w, b.h );
+}
+
+static void pendulum_update_proc( Layer* lay, GContext* ctx )
+{
+   pendulum* pend = (pendulum*) lay;
+   const pendulum_path* path = &pend->path;
+   uint32_t start = hw_timer_get_time();
+   GRect frame = layer_get_frame( lay );
+   int16_t dx = frame.origin.x;
+   int16_t dy = frame.origin.y;
+   uint16_t elapsed;
+
+   graphics_context_set_fill_color( ctx, GColorWhite );
+   graphics_fill_rect( ctx, GRect( 0, 0, frame.size.w, frame.size.h ),
+                       0, GCornerNone );
+
+   graphics_context_set_fill_color( ctx, GColorBlack );
+   graphics_context_set_stroke_color( ctx, GColorBlack );
+   if( path->style == PENDULUM_SWEEP ) {
+      graphics_fill_rect( ctx,
+                          GRect( path->bar_x - dx,
+                                 path->area.y - dy,
+                                 PENDULUM_BAR_WIDTH,
+                                 path->area.h ),
+                          0, GCornerNone );
+   } else {
+      int16_t px;
+      int16_t py;
+      GPoint bob = GPoint( path->bob_x - dx, path->bob_y - dy );
+
+      pendulum_path_pivot( path, &px, &py );
+      graphics_draw_line( ctx, GPoint( px - dx, py - dy ), bob );
+      graphics_fill_circle( ctx, bob, PENDULUM_BOB_RADIUS );
+   }
+
+   elapsed = hw_timer_get_time() - start;
+   pend->stats.last_frame_ms = elapsed;
+   if( elapsed > pend->stats.max_frame_ms ) {
+      pend->stats.max_frame_ms = elapsed;
+   }
+}
+
+static void frame( pendulum* pend )
+{
+   pendulum_box dirty;
+
+   pend->frame_timer = timer_stack_send_event( pend->ctx,
+                                               pend->frame_interval,
+                                               0,
+                                               frame_source );
+
+   if( ! pendulum_path_frame( &pend->path,
+                              hw_timer_get_time(),
+                              &pend->stats,
+                              &dirty ) ) {
+      return;
+   }
+
+   layer_set_frame( &pend->layer, to_grect( dirty ) );
+   layer_set_bounds( &pend->layer, GRect( 0, 0, dirty.w, dirty.h ) );
+   layer_mark_dirty( &pend->layer );
+}
+
+void pendulum_init( pendulum* pend,
+                    Layer* parent,
+                    GRect area,
+                    AppContextRef ctx )
+{
+   memset( pend, 0, sizeof(*pend) );
+   pend->frame_interval = PENDULUM_DEFAULT_FRAME_INTERVAL;
+   pend->path.area.x = area.origin.x;
+   pend->path.area.y = area.origin.y;
+   pend->path.area.w = area.size.w;
+   pend->path.area.h = area.size.h;
+   pend->ctx = ctx;
+
+   pendulum_path_place( &pend->path, 0 );
+   pend->path.old_box = pendulum_path_box( &pend->path );
+
+   layer_init( &pend->layer, to_grect( pend->path.old_box ) );
+   pend->layer.update_proc = (LayerUpdateProc) &pendulum_update_proc;
+   layer_set_hidden( &pend->layer, true );
+   layer_add_child( parent, &pend->layer );
+}
+
+void pendulum_set_style( pendulum* pend, pendulum_style style )
+{
+   pendulum_path* path = &pend->path;
+
+   path->style = style;
+   path->old_box = pendulum_box_union( path->old_box,
+                                       pendulum_path_box( path ) );
+   pendulum_path_place( path, path->beat_time );
+}
+
+void pendulum_set_hidden( pendulum* pend, bool hidden )
+{
+   layer_set_hidden( &pend->layer, hidden );
+}
+
+void pendulum_start( pendulum* pend )
+{
+   if( ! pend->running ) {
+      pend->running = true;
+      pend->frame_timer = timer_stack_send_event( pend->ctx,
+                                                  pend->frame_interval,
+                                                  0,
+                                                  frame_source );
+   }
+}
+
+void pendulum_stop( pendulum* pend )
+{
+   if( pend->running ) {
+      pend->running = false;
+      timer_stack_cancel_event( pend->ctx, pend->frame_timer );
+   }
+}
+
+void pendulum_beat( pendulum* pend,
+                    uint32_t beat_time,
+                    uint32_t beat_interval )
+{
+   pendulum_path_beat( &pend->path, beat_time, beat_interval );
+}
+
+bool pendulum_handle_timeout( pendulum* pend,
+                              AppTimerHandle handle )
+{
+   if( handle != pend->frame_timer ) {
+      return false;
+   }
+
+   if( pend->running ) {
+      frame( pend );
+   }
+   return true;
+}
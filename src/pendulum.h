@@ -0,0 +1,79 @@
+#ifndef PENDULUM_H
+#define PENDULUM_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pendulum_path.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// pendulum.h
+//
+// An animated beat visual for the metronome window: either a
+// swinging pendulum or a bar sweeping back and forth.  Its position
+// is worked out from the beat phase with a fixed-point sine table, so
+// it stays locked to the beat grid however late a frame is drawn.
+//
+// Only what moved is redrawn.  Each frame, the pendulum's layer is
+// moved to cover the union of the old and the new bounding box of
+// the drawing and marked dirty; its update proc clears that box and
+// draws the new position.
+//
+// Frames are skipped outright when the last frame's cost says the
+// frame wouldn't be finished before the next beat is due - the beat
+// always wins.
+//
+// The motion, boxes and skipping are in pendulum_path.h; this is the
+// Layer and the frame timer around them.
+//
+// To use this:
+//
+// 1.  Call pendulum_init() once the window's other layers are set up.
+//
+// 2.  Call pendulum_start() when the metronome starts and
+//     pendulum_beat() on every beat; pendulum_stop() when it stops.
+//
+// 3.  Chain pendulum_handle_timeout() into the window's timer_stack
+//     handler.
+
+typedef struct {
+   // Must be first - the update proc gets handed this.
+   Layer layer;
+
+   // You can change stuff here.
+   int frame_interval;
+
+   // Don't touch!!
+   pendulum_path path;
+
+   bool running;
+   AppTimerHandle frame_timer;
+   AppContextRef ctx;
+
+   pendulum_stats stats;
+} pendulum;
+
+#define PENDULUM_DEFAULT_FRAME_INTERVAL (50) // ms
+
+void pendulum_init( pendulum* pend,
+                    Layer* parent,
+                    GRect area,
+                    AppContextRef ctx );
+
+void pendulum_set_style( pendulum* pend, pendulum_style style );
+
+void pendulum_set_hidden( pendulum* pend, bool hidden );
+
+void pendulum_start( pendulum* pend );
+
+void pendulum_stop( pendulum* pend );
+
+// A beat (grid point at beat_time, hw_timer ms) has just sounded.
+void pendulum_beat( pendulum* pend,
+                    uint32_t beat_time,
+                    uint32_t beat_interval );
+
+bool pendulum_handle_timeout( pendulum* pend,
+                              AppTimerHandle handle );
+
+#endif
@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////
+//
+// pendulum_path.c
+//
+// Pendulum / sweeping bar position and dirty boxes.
+//
+// See pendulum_path.h for more information.
+//
+
+#include "pendulum_path.h"
+
+// Quarter-wave sine, Q14.  Angles are binary: 256 to the circle.
+static const int16_t sin_q14[65] = {
+       0,   402,   804,  1205,  1606,  2006,  2404,  2801,
+    3196,  3590,  3981,  4370,  4756,  5139,  5520,  5897,
+    6270,  6639,  7005,  7366,  7723,  8076,  8423,  8765,
+    9102,  9434,  9760, 10080, 10394, 10702, 11003, 11297,
+   11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395,
+   13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978,
+   15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986,
+   16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379,
+   16384,
+};
+
+// Widest swing either side of vertical, binary angle (~39 deg).
+#define SWING_MAX_ANGLE (28)
+
+// Don't start a frame this close to a beat, on top of what the last
+// frame cost.
+#define BEAT_GUARD_MS (5)
+
+static int32_t sin_lookup( uint8_t angle )
+{
+   uint8_t idx = angle & 0x3F;
+
+   switch( angle >> 6 ) {
+   case 0: return sin_q14[idx];
+   case 1: return sin_q14[64 - idx];
+   case 2: return -sin_q14[idx];
+   default: return -sin_q14[64 - idx];
+   }
+}
+
+static int32_t cos_lookup( uint8_t angle )
+{
+   return sin_lookup( angle + 64 );
+}
+
+static pendulum_box box( int16_t x, int16_t y, int16_t w, int16_t h )
+{
+   pendulum_box b = { x, y, w, h };
+
+   return b;
+}
+
+pendulum_box pendulum_box_union( pendulum_box a, pendulum_box b )
+{
+   int16_t x0 = ( a.x < b.x ) ? a.x : b.x;
+   int16_t y0 = ( a.y < b.y ) ? a.y : b.y;
+   int16_t ax1 = a.x + a.w;
+   int16_t bx1 = b.x + b.w;
+   int16_t ay1 = a.y + a.h;
+   int16_t by1 = b.y + b.h;
+
+   return box( x0, y0,
+               ( ( ax1 > bx1 ) ? ax1 : bx1 ) - x0,
+               ( ( ay1 > by1 ) ? ay1 : by1 ) - y0 );
+}
+
+static int16_t pivot_x( const pendulum_path* path )
+{
+   return path->area.x + path->area.w / 2;
+}
+
+static int16_t pivot_y( const pendulum_path* path )
+{
+   return path->area.y + path->area.h - 1;
+}
+
+void pendulum_path_pivot( const pendulum_path* path,
+                          int16_t* x,
+                          int16_t* y )
+{
+   *x = pivot_x( path );
+   *y = pivot_y( path );
+}
+
+pendulum_box pendulum_path_box( const pendulum_path* path )
+{
+   if( path->style == PENDULUM_SWEEP ) {
+      return box( path->bar_x, path->area.y,
+                  PENDULUM_BAR_WIDTH, path->area.h );
+   } else {
+      int16_t px = pivot_x( path );
+      int16_t x0 = ( px < path->bob_x ) ? px : path->bob_x;
+      int16_t x1 = ( px < path->bob_x ) ? path->bob_x : px;
+
+      return box( x0 - PENDULUM_BOB_RADIUS,
+                  path->bob_y - PENDULUM_BOB_RADIUS,
+                  x1 - x0 + 2 * PENDULUM_BOB_RADIUS + 1,
+                  pivot_y( path ) - path->bob_y
+                     + PENDULUM_BOB_RADIUS + 1 );
+   }
+}
+
+void pendulum_path_place( pendulum_path* path, uint32_t now )
+{
+   uint32_t elapsed = now - path->beat_time;
+   uint32_t phase_q8;
+
+   if( path->beat_interval == 0 ) {
+      phase_q8 = 0;
+   } else {
+      if( elapsed > path->beat_interval ) {
+         elapsed = path->beat_interval;
+      }
+      phase_q8 = ( elapsed << 8 ) / path->beat_interval;
+   }
+
+   if( path->style == PENDULUM_SWEEP ) {
+      int16_t travel = path->area.w - PENDULUM_BAR_WIDTH;
+      int16_t offset = ( travel * phase_q8 ) >> 8;
+      path->bar_x = path->area.x
+                  + ( path->reverse ? travel - offset : offset );
+   } else {
+      // At each beat the pendulum is at the end of its swing; it
+      // passes vertical half way between.  phase_q8 / 2 is the phase
+      // as a binary angle from 0 to pi.
+      int16_t len = path->area.h - PENDULUM_BOB_RADIUS - 2;
+      int32_t theta = ( SWING_MAX_ANGLE
+                        * cos_lookup( (uint8_t) ( phase_q8 >> 1 ) ) ) >> 14;
+
+      if( ! path->reverse ) {
+         theta = -theta;
+      }
+      path->bob_x = pivot_x( path )
+                  + ( ( len * sin_lookup( (uint8_t) theta ) ) >> 14 );
+      path->bob_y = pivot_y( path )
+                  - ( ( len * cos_lookup( (uint8_t) theta ) ) >> 14 );
+   }
+}
+
+void pendulum_path_beat( pendulum_path* path,
+                         uint32_t beat_time,
+                         uint32_t beat_interval )
+{
+   path->beat_time = beat_time;
+   path->beat_interval = beat_interval;
+   path->reverse = ! path->reverse;
+}
+
+bool pendulum_path_frame( pendulum_path* path,
+                          uint32_t now,
+                          pendulum_stats* stats,
+                          pendulum_box* dirty )
+{
+   uint32_t next_beat = path->beat_time + path->beat_interval;
+   int32_t to_beat = (int32_t) ( next_beat - now );
+   pendulum_box new_box;
+
+   if(    to_beat >= 0
+       && to_beat < stats->last_frame_ms + BEAT_GUARD_MS ) {
+      stats->frames_skipped++;
+      return false;
+   }
+
+   pendulum_path_place( path, now );
+   new_box = pendulum_path_box( path );
+   *dirty = pendulum_box_union( path->old_box, new_box );
+   path->old_box = new_box;
+
+   stats->frames_drawn++;
+   stats->last_pixels = dirty->w * dirty->h;
+   if( stats->last_pixels > stats->max_pixels ) {
+      stats->max_pixels = stats->last_pixels;
+   }
+   return true;
+}
@@ -0,0 +1,93 @@
+#ifndef PENDULUM_PATH_H
+#define PENDULUM_PATH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// pendulum_path.h
+//
+// Where the pendulum (or sweeping bar) is at any moment, and what each
+// frame has to redraw - everything about the animation but the
+// drawing, so tools/pendulum_sim.c can run it on the host.
+//
+// To use this:
+//
+// 1.  Set style and area, then pendulum_path_place() it at the start,
+//     and set old_box to pendulum_path_box().
+//
+// 2.  On every beat, call pendulum_path_beat().
+//
+// 3.  On every frame timer, call pendulum_path_frame().  If it returns
+//     true, redraw the dirty box it hands back.
+
+#define PENDULUM_BOB_RADIUS (5)
+#define PENDULUM_BAR_WIDTH (6)
+
+typedef enum {
+   PENDULUM_SWING = 0,
+   PENDULUM_SWEEP,
+} pendulum_style;
+
+typedef struct {
+   int16_t x;
+   int16_t y;
+   int16_t w;
+   int16_t h;
+} pendulum_box;
+
+typedef struct {
+   uint32_t frames_drawn;
+   uint32_t frames_skipped;
+   // Pixels covered by the dirty box.
+   uint16_t last_pixels;
+   uint16_t max_pixels;
+   // Time spent in the update proc, ms.
+   uint16_t last_frame_ms;
+   uint16_t max_frame_ms;
+} pendulum_stats;
+
+typedef struct {
+   pendulum_style style;
+   pendulum_box area;
+
+   // Don't touch!!
+   int16_t bob_x;
+   int16_t bob_y;
+   int16_t bar_x;
+   pendulum_box old_box;
+
+   uint32_t beat_time;
+   uint32_t beat_interval;
+   bool reverse;
+} pendulum_path;
+
+// Work out where things are at now from the beat phase.
+void pendulum_path_place( pendulum_path* path, uint32_t now );
+
+// Where the pendulum hangs from.
+void pendulum_path_pivot( const pendulum_path* path,
+                          int16_t* x,
+                          int16_t* y );
+
+// What covers the drawing where it was last placed.
+pendulum_box pendulum_path_box( const pendulum_path* path );
+
+pendulum_box pendulum_box_union( pendulum_box a, pendulum_box b );
+
+// A beat (grid point at beat_time, hw_timer ms) has just sounded.
+void pendulum_path_beat( pendulum_path* path,
+                         uint32_t beat_time,
+                         uint32_t beat_interval );
+
+// A frame is due at now.  Returns false if it's skipped - by the last
+// frame's cost, it wouldn't be finished before the next beat.
+// Otherwise it's placed, and *dirty is the union of the old and new
+// boxes.  Either way, stats are kept.
+bool pendulum_path_frame( pendulum_path* path,
+                          uint32_t now,
+                          pendulum_stats* stats,
+                          pendulum_box* dirty );
+
+#endif
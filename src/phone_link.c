@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////
+//
+// phone_link.c
+//
+// AppMessage transport shared by the phone protocols.
+//
+// See phone_link.h for more information.
+//
+
+#include "phone_link.h"
+
+#include <string.h>
+
+static AppMessageCallbacksNode link_callbacks;
+
+static phone_link_handler handlers[PHONE_LINK_NUM_KEYS];
+
+// The outbox is ours from app_message_out_get() until the sent/failed
+// callback.
+static bool outbox_busy;
+
+typedef struct {
+   uint8_t data[PHONE_LINK_MAX_MESSAGE];
+   uint16_t len;
+} queued_message;
+
+static queued_message queue[PHONE_LINK_NUM_KEYS];
+
+static void send_queued( void )
+{
+   DictionaryIterator* iter;
+   uint8_t key;
+
+   if( outbox_busy ) {
+      return;
+   }
+   for( key = 0; key < PHONE_LINK_NUM_KEYS; key++ ) {
+      if( queue[key].len > 0 ) {
+         break;
+      }
+   }
+   if( key == PHONE_LINK_NUM_KEYS ) {
+      return;
+   }
+
+   if( app_message_out_get( &iter ) != APP_MSG_OK ) {
+      return;
+   }
+   dict_write_data( iter, key, queue[key].data, queue[key].len );
+   dict_write_end( iter );
+   if( app_message_out_send() != APP_MSG_OK ) {
+      app_message_out_release();
+      return;
+   }
+   outbox_busy = true;
+   queue[key].len = 0;
+}
+
+static void link_out_sent( DictionaryIterator* sent, void* ctx )
+{
+   app_message_out_release();
+   outbox_busy = false;
+   send_queued();
+}
+
+static void link_out_failed( DictionaryIterator* failed,
+                             AppMessageResult reason,
+                             void* ctx )
+{
+   // Don't retry - the phone will resend whatever it didn't hear
+   // about, and clock sync would rather have a fresh timestamp.
+   app_message_out_release();
+   outbox_busy = false;
+   send_queued();
+}
+
+static void link_in_received( DictionaryIterator* received, void* ctx )
+{
+   uint8_t reply[PHONE_LINK_MAX_MESSAGE];
+
+   for( uint8_t key = 0; key < PHONE_LINK_NUM_KEYS; key++ ) {
+      Tuple* t = dict_find( received, key );
+      uint16_t len;
+
+      if(    t == NULL
+          || t->type != TUPLE_BYTE_ARRAY
+          || handlers[key] == NULL ) {
+         continue;
+      }
+      len = (*handlers[key])( t->value->data, t->length, reply );
+      if( len > 0 ) {
+         phone_link_send( key, reply, len );
+      }
+   }
+}
+
+void phone_link_init_once( void )
+{
+   link_callbacks.callbacks.out_sent = &link_out_sent;
+   link_callbacks.callbacks.out_failed = &link_out_failed;
+   link_callbacks.callbacks.in_received = &link_in_received;
+   app_message_register_callbacks( &link_callbacks );
+}
+
+void phone_link_set_handler( uint8_t key, phone_link_handler handler )
+{
+   handlers[key] = handler;
+}
+
+void phone_link_send( uint8_t key, const uint8_t* msg, uint16_t len )
+{
+   if( key >= PHONE_LINK_NUM_KEYS || len > PHONE_LINK_MAX_MESSAGE ) {
+      return;
+   }
+   memcpy( queue[key].data, msg, len );
+   queue[key].len = len;
+   send_queued();
+}
@@ -0,0 +1,58 @@
+#ifndef PHONE_LINK_H
+#define PHONE_LINK_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// phone_link.h
+//
+// Shares the one AppMessage link to the phone between the protocols
+// that run over it - preset pushes (see preset_proto.h), ensemble
+// clock sync (see clock_sync.h) and timer trace reads (see
+// timer_trace.h).
+//
+// Each protocol owns a dictionary key, and each message travels as a
+// single byte-array tuple under its protocol's key.  Inbound messages
+// go to the handler registered for the key, and whatever it returns
+// is sent back as the reply.
+//
+// There's only one outbox.  If it's still busy, an outbound message
+// waits in a one-deep queue per key - a newer message for a key
+// replaces an older one still waiting - and goes out when the outbox
+// frees up.  Every protocol resends anything that isn't answered, so a
+// replaced message costs a retry, not a transfer.
+//
+// To use this:
+//
+// 1.  Set PHONE_LINK_INBOUND_SIZE and PHONE_LINK_OUTBOUND_SIZE as the
+//     messaging_info buffer sizes in pbl_main().
+//
+// 2.  Call phone_link_init_once() in your app init function, then
+//     phone_link_set_handler() for each key.
+
+#define PHONE_LINK_PRESET_KEY (0)
+#define PHONE_LINK_SYNC_KEY (1)
+#define PHONE_LINK_TRACE_KEY (2)
+#define PHONE_LINK_NUM_KEYS (3)
+
+// Largest message either way, not counting the dictionary.
+#define PHONE_LINK_MAX_MESSAGE (48)
+
+// A full chunk of four presets, plus dictionary overhead.
+#define PHONE_LINK_INBOUND_SIZE (124)
+#define PHONE_LINK_OUTBOUND_SIZE (PHONE_LINK_MAX_MESSAGE + 16)
+
+// Handle msg; write any reply to reply and return its length, or 0.
+typedef uint16_t (* phone_link_handler)( const uint8_t* msg,
+                                         uint16_t len,
+                                         uint8_t* reply );
+
+void phone_link_init_once( void );
+
+void phone_link_set_handler( uint8_t key, phone_link_handler handler );
+
+void phone_link_send( uint8_t key, const uint8_t* msg, uint16_t len );
+
+#endif
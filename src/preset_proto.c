@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////
+//
+// preset_proto.c
+//
+// Chunked, sequenced preset transfer - watch side.
+//
+// See preset_proto.h for more information.
+//
+
+#include "preset_proto.h"
+
+#include <string.h>
+
+static uint16_t get_u16( const uint8_t* p )
+{
+   return p[0] | ( p[1] << 8 );
+}
+
+static void put_u16( uint8_t* p, uint16_t v )
+{
+   p[0] = v & 0xFF;
+   p[1] = v >> 8;
+}
+
+static uint16_t put_header( uint8_t* reply,
+                            uint8_t type,
+                            uint16_t session,
+                            uint16_t seq )
+{
+   reply[0] = type;
+   put_u16( &reply[1], session );
+   put_u16( &reply[3], seq );
+   return PRESET_HEADER_SIZE;
+}
+
+void preset_store_init( preset_store* store,
+                        preset_settings_handler on_settings )
+{
+   memset( store, 0, sizeof(*store) );
+   store->on_settings = on_settings;
+}
+
+// Fletcher-16.  Never 0 for a used slot, so 0 can mean empty.
+uint16_t preset_checksum( const preset* p )
+{
+   const uint8_t* data = (const uint8_t*) p;
+   uint16_t a = 0;
+   uint16_t b = 0;
+
+   if( p->name[0] == '\0' ) {
+      return 0;
+   }
+
+   for( unsigned int i = 0; i < sizeof(*p); i++ ) {
+      a = ( a + data[i] ) % 255;
+      b = ( b + a ) % 255;
+   }
+
+   return ( ( b << 8 ) | a ) | 0x8000;
+}
+
+// Check the whole chunk is well formed before applying any of it, so
+// a truncated chunk can't leave half its entries applied.
+static bool chunk_valid( const uint8_t* body, uint16_t len )
+{
+   uint8_t num_entries;
+   uint16_t pos = 1;
+
+   if( len < 1 ) {
+      return false;
+   }
+   num_entries = body[0];
+
+   for( uint8_t e = 0; e < num_entries; e++ ) {
+      if( pos >= len ) {
+         return false;
+      }
+      switch( body[pos] ) {
+      case PRESET_ENTRY_PRESET:
+         if(    pos + 2 + sizeof(preset) > len
+             || body[pos + 1] >= PRESET_MAX_SLOTS ) {
+            return false;
+         }
+         pos += 2 + sizeof(preset);
+         break;
+      case PRESET_ENTRY_DELETE:
+         if( pos + 2 > len || body[pos + 1] >= PRESET_MAX_SLOTS ) {
+            return false;
+         }
+         pos += 2;
+         break;
+      case PRESET_ENTRY_SETTINGS:
+         if( pos + 1 + sizeof(preset_settings) > len ) {
+            return false;
+         }
+         pos += 1 + sizeof(preset_settings);
+         break;
+      default:
+         return false;
+      }
+   }
+
+   return pos == len;
+}
+
+static void apply_chunk( preset_store* store,
+                         const uint8_t* body,
+                         uint16_t len )
+{
+   uint8_t num_entries = body[0];
+   uint16_t pos = 1;
+
+   for( uint8_t e = 0; e < num_entries; e++ ) {
+      switch( body[pos] ) {
+      case PRESET_ENTRY_PRESET: {
+         preset* p = &store->slots[body[pos + 1]];
+         memcpy( p, &body[pos + 2], sizeof(*p) );
+         p->name[PRESET_NAME_SIZE - 1] = '\0';
+         pos += 2 + sizeof(preset);
+         break;
+      }
+      case PRESET_ENTRY_DELETE:
+         memset( &store->slots[body[pos + 1]], 0, sizeof(preset) );
+         pos += 2;
+         break;
+      case PRESET_ENTRY_SETTINGS: {
+         preset_settings settings;
+         memcpy( &settings, &body[pos + 1], sizeof(settings) );
+         if( store->on_settings ) {
+            (*store->on_settings)( &settings );
+         }
+         pos += 1 + sizeof(preset_settings);
+         break;
+      }
+      }
+   }
+
+   store->stats.bytes += len;
+}
+
+uint16_t preset_proto_handle( preset_store* store,
+                              const uint8_t* msg,
+                              uint16_t len,
+                              uint8_t* reply )
+{
+   uint16_t session;
+   uint16_t seq;
+   uint16_t out;
+
+   if( len < PRESET_HEADER_SIZE ) {
+      store->stats.bad++;
+      return 0;
+   }
+   session = get_u16( &msg[1] );
+   seq = get_u16( &msg[3] );
+
+   switch( msg[0] ) {
+   case PRESET_MSG_HELLO:
+      if( session != store->session ) {
+         store->session = session;
+         store->next_seq = 0;
+      }
+      out = put_header( reply, PRESET_MSG_STATUS,
+                        session, store->next_seq );
+      reply[out++] = PRESET_MAX_SLOTS;
+      for( int s = 0; s < PRESET_MAX_SLOTS; s++ ) {
+         put_u16( &reply[out], preset_checksum( &store->slots[s] ) );
+         out += 2;
+      }
+      return out;
+
+   case PRESET_MSG_CHUNK:
+      if( session != store->session ) {
+         // Not the transfer we're in - make the phone say HELLO.
+         store->stats.bad++;
+         return 0;
+      }
+      if( seq == store->next_seq ) {
+         if( ! chunk_valid( &msg[PRESET_HEADER_SIZE],
+                            len - PRESET_HEADER_SIZE ) ) {
+            store->stats.bad++;
+         } else {
+            apply_chunk( store,
+                         &msg[PRESET_HEADER_SIZE],
+                         len - PRESET_HEADER_SIZE );
+            store->next_seq++;
+            store->stats.chunks++;
+         }
+      } else if( (int16_t) ( seq - store->next_seq ) < 0 ) {
+         store->stats.duplicates++;
+      } else {
+         store->stats.gaps++;
+      }
+      // Always ack the last chunk applied in order.
+      return put_header( reply, PRESET_MSG_ACK,
+                         session, store->next_seq - 1 );
+
+   default:
+      store->stats.bad++;
+      return 0;
+   }
+}
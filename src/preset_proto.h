@@ -0,0 +1,121 @@
+#ifndef PRESET_PROTO_H
+#define PRESET_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// preset_proto.h
+//
+// The watch side of the companion preset protocol: the phone pushes
+// presets (named tempo/meter/groove settings) and app settings to the
+// watch in batched, chunked messages.  This file knows nothing about
+// AppMessage - it turns one inbound message into at most one reply -
+// so it can be driven by anything that moves bytes.  See phone_link
+// for the AppMessage glue.
+//
+// All integers are little-endian.  Every message starts with
+//
+//    u8 type, u16 session, u16 seq
+//
+// Phone to watch:
+//
+//    HELLO   Start or resume a transfer in 'session'.  The watch
+//            answers STATUS.  A new session id starts from seq 0; the
+//            same id picks up where it left off.
+//
+//    CHUNK   u8 num_entries, then the entries, each one of
+//               u8 PRESET_ENTRY_PRESET, u8 slot, preset (24 bytes)
+//               u8 PRESET_ENTRY_DELETE, u8 slot
+//               u8 PRESET_ENTRY_SETTINGS, preset_settings (4 bytes)
+//            The watch answers ACK.
+//
+// Watch to phone:
+//
+//    STATUS  u8 num_slots, then a u16 checksum per slot (0 for an
+//            empty slot).  seq is the next seq the watch expects.
+//            The phone compares checksums against its own copy and
+//            only sends the slots that differ.
+//
+//    ACK     seq is the last chunk applied, in order.  A chunk is
+//            only applied when its seq is the next one expected; a
+//            repeat of an old chunk is acked again but not
+//            re-applied, and a chunk after a gap is dropped and the
+//            ack tells the phone where to resume.
+//
+// Work per message is bounded by the size of one chunk - a handful of
+// 24-byte copies - so a transfer never holds up the beat.
+
+#define PRESET_MAX_SLOTS (16)
+#define PRESET_NAME_SIZE (16)
+
+#define PRESET_HEADER_SIZE (5)
+
+// Largest reply, not counting the AppMessage dictionary.
+#define PRESET_MAX_MESSAGE (PRESET_HEADER_SIZE + 1 + 2 * PRESET_MAX_SLOTS)
+
+// Message types.
+#define PRESET_MSG_HELLO (0x01)
+#define PRESET_MSG_CHUNK (0x02)
+#define PRESET_MSG_STATUS (0x81)
+#define PRESET_MSG_ACK (0x82)
+
+// Chunk entry types.
+#define PRESET_ENTRY_PRESET (0x01)
+#define PRESET_ENTRY_DELETE (0x02)
+#define PRESET_ENTRY_SETTINGS (0x03)
+
+typedef struct {
+   // NUL-padded; an empty name means an empty slot.
+   char name[PRESET_NAME_SIZE];
+   uint8_t tempo;
+   uint8_t beats_per_bar;
+   uint8_t beat_unit;
+   uint8_t subdivisions;
+   uint8_t swing_pct;
+   int8_t shift_ms;
+   uint8_t reserved[2];
+} preset;
+
+typedef struct {
+   uint8_t vibe_dur;
+   uint8_t stop_after;
+   uint8_t vibe_enabled;
+   uint8_t reserved;
+} preset_settings;
+
+typedef void (* preset_settings_handler)( const preset_settings* settings );
+
+typedef struct {
+   uint32_t chunks;      // applied
+   uint32_t duplicates;  // re-sent chunks, acked but not applied
+   uint32_t gaps;        // out-of-order chunks dropped
+   uint32_t bad;         // malformed messages
+   uint32_t bytes;       // payload bytes applied
+} preset_proto_stats;
+
+typedef struct {
+   preset slots[PRESET_MAX_SLOTS];
+
+   // Don't touch!!
+   uint16_t session;
+   uint16_t next_seq;
+   preset_settings_handler on_settings;
+   preset_proto_stats stats;
+} preset_store;
+
+void preset_store_init( preset_store* store,
+                        preset_settings_handler on_settings );
+
+uint16_t preset_checksum( const preset* p );
+
+// Handle one inbound message.  Any reply (at most PRESET_MAX_MESSAGE
+// bytes) is written to reply and its length returned; 0 means no
+// reply.
+uint16_t preset_proto_handle( preset_store* store,
+                              const uint8_t* msg,
+                              uint16_t len,
+                              uint8_t* reply );
+
+#endif
@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////
+//
+// song_map.c
+//
+// Section-by-section song playback.
+//
+// See song_map.h for more information.
+//
+
+#include "song_map.h"
+
+#include <string.h>
+
+static void reset_pos( song_map* map )
+{
+   memset( &map->pos, 0, sizeof(map->pos) );
+   map->done = false;
+   map->section_bar = 0;
+   map->next_ready = false;
+   map->has_next = false;
+}
+
+void song_map_init( song_map* map )
+{
+   memset( map, 0, sizeof(*map) );
+   map->section.beats_per_bar = 4;
+   map->section.beat_unit = 4;
+   map->section.subdivisions = 1;
+   map->section.swing_pct = GROOVE_MIN_SWING_PCT;
+}
+
+bool song_map_load_song( song_map* map, uint16_t song )
+{
+   library_cursor cur;
+   library_section sec;
+
+   if(    library_open_song( song, &cur ) == 0
+       || ! library_next_section( &cur, &sec )
+       || sec.tempo == 0
+       || sec.beats_per_bar == 0 ) {
+      return false;
+   }
+
+   map->from_library = true;
+   map->song = song;
+   map->cur = cur;
+   map->section = sec;
+   reset_pos( map );
+   return true;
+}
+
+void song_map_load_section( song_map* map, const library_section* sec )
+{
+   map->from_library = false;
+   map->section = *sec;
+   reset_pos( map );
+}
+
+const library_section* song_map_section( const song_map* map )
+{
+   return &map->section;
+}
+
+void song_map_section_groove( const library_section* sec,
+                              groove_template* groove )
+{
+   groove_template_init( groove );
+   groove->subdivisions = sec->subdivisions;
+   groove->swing_pct = sec->swing_pct;
+   groove->shift_ms = sec->shift_ms;
+   groove_template_clamp( groove );
+}
+
+bool song_map_rewind( song_map* map )
+{
+   if( ! map->from_library ) {
+      reset_pos( map );
+      return false;
+   }
+
+   // Once the cursor has read ahead, the song has to be opened again.
+   if( map->pos.section > 0 || map->next_ready ) {
+      return song_map_load_song( map, map->song );
+   }
+   reset_pos( map );
+   return true;
+}
+
+void song_map_prefetch( song_map* map )
+{
+   if( map->next_ready ) {
+      return;
+   }
+   map->next_ready = true;
+
+   // A section that can't be played ends the song.
+   map->has_next =    map->from_library
+                   && library_next_section( &map->cur, &map->next )
+                   && map->next.tempo > 0
+                   && map->next.beats_per_bar > 0;
+   if( map->has_next ) {
+      song_map_section_groove( &map->next, &map->next_groove );
+      groove_build( &map->next_tab, &map->next_groove, map->next.tempo );
+   }
+}
+
+song_map_step song_map_advance( song_map* map,
+                                groove_template* groove,
+                                groove_table* tab )
+{
+   map->pos.beats++;
+   if( ++map->pos.beat < map->section.beats_per_bar ) {
+      return SONG_MAP_SAME_SECTION;
+   }
+   map->pos.beat = 0;
+   map->pos.bar++;
+
+   // bars of 0 plays the section forever.
+   if(    map->section.bars == 0
+       || ++map->section_bar < map->section.bars ) {
+      return SONG_MAP_SAME_SECTION;
+   }
+
+   // Only if the caller never got round to it.
+   song_map_prefetch( map );
+   if( ! map->has_next ) {
+      map->done = true;
+      return SONG_MAP_END;
+   }
+
+   map->section = map->next;
+   map->section_bar = 0;
+   map->pos.section++;
+   *groove = map->next_groove;
+   *tab = map->next_tab;
+   map->next_ready = false;
+   map->has_next = false;
+   return SONG_MAP_NEW_SECTION;
+}
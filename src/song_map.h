@@ -0,0 +1,103 @@
+#ifndef SONG_MAP_H
+#define SONG_MAP_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "library.h"
+#include "groove.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// song_map.h
+//
+// Plays a song section by section - each with its own tempo, meter,
+// groove and number of bars - and keeps the position in it as a bar
+// and beat.
+//
+// Sections are read from the library through a cursor as the song
+// goes, so a song of any length costs two sections of RAM.  The next
+// section is read, and its groove table built, ahead of time - call
+// song_map_prefetch() once the beat's timer is armed - so crossing
+// into it is a copy: the new section's first beat lands exactly one
+// old beat after the last one, with nothing computed in between.
+//
+// Without a song, the map plays one section of 4/4 forever; a preset
+// is one section too.
+//
+// To use this:
+//
+// 1.  Call song_map_init(), then load a song or section whenever one
+//     is chosen.
+//
+// 2.  At the end of each beat, call song_map_advance().  On
+//     SONG_MAP_NEW_SECTION, switch to the groove and table it hands
+//     back.  On SONG_MAP_END, the song is over - don't play the next
+//     beat.
+//
+// 3.  Call song_map_rewind() when the beat stops, so the song starts
+//     from the top next time.
+
+typedef struct {
+   // Beats since the start.
+   uint32_t beats;
+   // Bars since the start of the song.
+   uint16_t bar;
+   // Beat within the bar, 0 being the downbeat.
+   uint8_t beat;
+   uint8_t section;
+} song_pos;
+
+typedef enum {
+   SONG_MAP_SAME_SECTION = 0,
+   SONG_MAP_NEW_SECTION,
+   SONG_MAP_END
+} song_map_step;
+
+typedef struct {
+   song_pos pos;
+   bool done;
+
+   // Where the sections come from: the song, or just the one.
+   bool from_library;
+   uint16_t song;
+   library_cursor cur;
+
+   library_section section;
+   uint16_t section_bar;
+
+   // The section after this one, read and built ahead.
+   bool next_ready;
+   bool has_next;
+   library_section next;
+   groove_template next_groove;
+   groove_table next_tab;
+} song_map;
+
+void song_map_init( song_map* map );
+
+// Returns false if the song can't be read; the map is unchanged.
+bool song_map_load_song( song_map* map, uint16_t song );
+
+void song_map_load_section( song_map* map, const library_section* sec );
+
+const library_section* song_map_section( const song_map* map );
+
+// The groove a section plays.
+void song_map_section_groove( const library_section* sec,
+                              groove_template* groove );
+
+// Back to the top.  Returns true for a song, whatever section it had
+// reached, so the caller must apply song_map_section() again: a song
+// always starts as written, while a lone section keeps any changes
+// made to it.
+bool song_map_rewind( song_map* map );
+
+// Read and build the next section, if that isn't done yet.
+void song_map_prefetch( song_map* map );
+
+// Move on one beat.
+song_map_step song_map_advance( song_map* map,
+                                groove_template* groove,
+                                groove_table* tab );
+
+#endif
@@ -1,5 +1,6 @@
 #include "spinner.h"
 #include "timer_stack.h"
+#include "event_storm.h"
 
 typedef struct {
    Window* win;
@@ -8,6 +9,9 @@ typedef struct {
 
 static spinner_to_win spinners[SPINNER_MAX_SPINNERS];
 
+// Fast-repeat timers, as timer_stack measures them.
+static const char* const spin_source = event_storm_spin_name;
+
 void spinner_config_click_provider( ClickConfig** config,
                                     void* context );
 
@@ -57,6 +61,7 @@ void spinner_init( spinner* spin,
    spin->start_fast_repeat_count = SPINNER_DEFAULT_FAST_REPEAT_COUNT;
    spin->repeat_interval = SPINNER_DEFAULT_REPEAT_INTERVAL;
    spin->fast_repeat_interval = SPINNER_DEFAULT_FAST_REPEAT_INTERVAL;
+   spin->press_down = false;
 
    spin->fast_up_timer = 0;
    spin->fast_down_timer = 0;
@@ -81,10 +86,10 @@ void spinner_deactivate( spinner* spin )
    }
 
    if( spin->fast_up_timer != 0 ) {
-      app_timer_cancel_event( spin->ctx, spin->fast_up_timer );
+      timer_stack_cancel_event( spin->ctx, spin->fast_up_timer );
    }
    if( spin->fast_down_timer != 0 ) {
-      app_timer_cancel_event( spin->ctx, spin->fast_down_timer );
+      timer_stack_cancel_event( spin->ctx, spin->fast_down_timer );
    }
 
    timer_stack_pop();
@@ -101,10 +106,20 @@ void spinner_config_click_provider( ClickConfig** config,
       return;
    }
 
-   config[BUTTON_ID_UP]->click.handler =
-      (ClickHandler) &spinner_up_handler;
-   config[BUTTON_ID_DOWN]->click.handler =
-      (ClickHandler) &spinner_down_handler;
+   if( spin->press_down ) {
+      // No click to wait for - the first step happens on the press.
+      config[BUTTON_ID_UP]->raw.down_handler =
+         (ClickHandler) &spinner_up_handler;
+      config[BUTTON_ID_UP]->raw.context = spin;
+      config[BUTTON_ID_DOWN]->raw.down_handler =
+         (ClickHandler) &spinner_down_handler;
+      config[BUTTON_ID_DOWN]->raw.context = spin;
+   } else {
+      config[BUTTON_ID_UP]->click.handler =
+         (ClickHandler) &spinner_up_handler;
+      config[BUTTON_ID_DOWN]->click.handler =
+         (ClickHandler) &spinner_down_handler;
+   }
 
    config[BUTTON_ID_UP]->long_click.handler =
       (ClickHandler) &spinner_long_up_handler;
@@ -149,15 +164,17 @@ bool spinner_handle_timeout( AppContextRef app_ctx,
       if( handle == spin->fast_up_timer ) {
          spinner_up_handler( (ClickRecognizerRef) NULL,
                              (void*) spin );
-         spin->fast_up_timer = app_timer_send_event( app_ctx,
-                                                     timeout,
-                                                     cookie );
+         spin->fast_up_timer = timer_stack_send_event( app_ctx,
+                                                       timeout,
+                                                       cookie,
+                                                       spin_source );
       } else if( handle == spin->fast_down_timer ) {
          spinner_down_handler( (ClickRecognizerRef) NULL,
                                (void*) spin );
-         spin->fast_down_timer = app_timer_send_event( app_ctx,
-                                                       timeout,
-                                                       cookie );
+         spin->fast_down_timer = timer_stack_send_event( app_ctx,
+                                                         timeout,
+                                                         cookie,
+                                                         spin_source );
       }
       return true;
    }
@@ -183,34 +200,42 @@ void spinner_long_up_handler( ClickRecognizerRef recognizer,
                               void* ctx )
 {
    spinner* spin = (spinner*) ctx;
-   spin->fast_up_timer = app_timer_send_event( spin->ctx,
-                                               spin->repeat_interval,
-                                               (uint32_t) spin );
+   spin->fast_up_timer = timer_stack_send_event( spin->ctx,
+                                                 spin->repeat_interval,
+                                                 (uint32_t) spin,
+                                                 spin_source );
    spin->num_fast_changes = 0;
-   (*spin->up_handler)( recognizer, ctx );
+   // With press_down, the press itself was the first step.
+   if( ! spin->press_down ) {
+      (*spin->up_handler)( recognizer, ctx );
+   }
 }
 
 void spinner_long_up_release_handler( ClickRecognizerRef recognizer,
                                       void* ctx )
 {
    spinner* spin = (spinner*) ctx;
-   app_timer_cancel_event( spin->ctx, spin->fast_up_timer );
+   timer_stack_cancel_event( spin->ctx, spin->fast_up_timer );
 }
 
 void spinner_long_down_handler( ClickRecognizerRef recognizer,
                                 void* ctx )
 {
    spinner* spin = (spinner*) ctx;
-   spin->fast_down_timer = app_timer_send_event( spin->ctx,
-                                                 spin->repeat_interval,
-                                                 (uint32_t) spin );
+   spin->fast_down_timer = timer_stack_send_event( spin->ctx,
+                                                   spin->repeat_interval,
+                                                   (uint32_t) spin,
+                                                   spin_source );
    spin->num_fast_changes = 0;
-   (*spin->down_handler)( recognizer, ctx );
+   // With press_down, the press itself was the first step.
+   if( ! spin->press_down ) {
+      (*spin->down_handler)( recognizer, ctx );
+   }
 }
 
 void spinner_long_down_release_handler( ClickRecognizerRef recognizer,
                                         void* ctx )
 {
    spinner* spin = (spinner*) ctx;
-   app_timer_cancel_event( spin->ctx, spin->fast_down_timer );
+   timer_stack_cancel_event( spin->ctx, spin->fast_down_timer );
 }
@@ -43,6 +43,11 @@ typedef struct {
 
    int repeat_interval;
    int fast_repeat_interval;
+   // Step as soon as up/down goes down, rather than on the click
+   // (release).  Holding it then repeats after start_repeat_delay,
+   // with no extra step when the hold is recognised.  Read when the
+   // window's click config is set up.
+   bool press_down;
 
    // Don't touch!!
    ClickHandler up_handler;
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////
+//
+// stress.c
+//
+// On-watch event storm driver.
+//
+// See stress.h for more information.
+//
+
+#include "stress.h"
+#include "event_storm.h"
+#include "timer_stack.h"
+#include "hw_timer.h"
+
+static AppContextRef ctx;
+static stress_work spin_work;
+static stress_work tap_work;
+static stress_work on_done;
+
+static bool running;
+static uint32_t start_time;
+static event_storm storm;
+static AppTimerHandle spin_timer;
+static AppTimerHandle tap_timer;
+
+static AppTimerHandle arm( uint8_t source )
+{
+   int32_t delay = (int32_t) ( event_storm_next( &storm, source )
+                               - hw_timer_get_time() );
+
+   if( delay < 0 ) {
+      delay = 0;
+   }
+   return timer_stack_send_event( ctx, delay, 0,
+                                  event_storm_sources[source].name );
+}
+
+void stress_init_once( AppContextRef new_ctx,
+                       stress_work new_spin_work,
+                       stress_work new_tap_work,
+                       stress_work new_on_done )
+{
+   ctx = new_ctx;
+   spin_work = new_spin_work;
+   tap_work = new_tap_work;
+   on_done = new_on_done;
+}
+
+void stress_start( void )
+{
+   running = true;
+   start_time = hw_timer_get_time();
+   event_storm_start( &storm, start_time );
+   timer_stack_measure_latency( true );
+
+   spin_timer = arm( EVENT_STORM_SPIN );
+   tap_timer = arm( EVENT_STORM_TAP );
+}
+
+void stress_stop( void )
+{
+   if( ! running ) {
+      return;
+   }
+   running = false;
+   timer_stack_measure_latency( false );
+   timer_stack_cancel_event( ctx, spin_timer );
+   timer_stack_cancel_event( ctx, tap_timer );
+}
+
+bool stress_running( void )
+{
+   return running;
+}
+
+bool stress_handle_timeout( AppTimerHandle handle )
+{
+   if( ! running || ( handle != spin_timer && handle != tap_timer ) ) {
+      return false;
+   }
+
+   if( hw_timer_get_time() - start_time >= EVENT_STORM_DURATION_MS ) {
+      stress_stop();
+      if( on_done ) {
+         (*on_done)();
+      }
+      return true;
+   }
+
+   if( handle == spin_timer ) {
+      (*spin_work)();
+      spin_timer = arm( EVENT_STORM_SPIN );
+   } else {
+      (*tap_work)();
+      tap_timer = arm( EVENT_STORM_TAP );
+   }
+   return true;
+}
@@ -0,0 +1,45 @@
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// stress.h
+//
+// Runs the event storm (see event_storm.h) on the watch for
+// EVENT_STORM_DURATION_MS, with timer_stack latency measurement on.
+//
+// The beat and pendulum are the app's own - set them to the storm
+// tempo and start them before calling stress_start().  This drives the
+// rest: stand-ins for the spinner's fast-repeat and the tap timeout,
+// armed on the storm's deadlines, each calling back into the app to
+// do the work the real one would.
+//
+// To use this:
+//
+// 1.  Call stress_init_once() in your app init function.
+//
+// 2.  Chain stress_handle_timeout() from a timer_stack handler that's
+//     on the stack while the storm runs.
+//
+// 3.  Call stress_start().  on_done is called when the storm is over;
+//     the latency stats are then in timer_stack.
+
+typedef void (* stress_work)( void );
+
+void stress_init_once( AppContextRef ctx,
+                       stress_work spin_work,
+                       stress_work tap_work,
+                       stress_work on_done );
+
+void stress_start( void );
+
+void stress_stop( void );
+
+bool stress_running( void );
+
+bool stress_handle_timeout( AppTimerHandle handle );
+
+#endif
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////
+//
+// tempo_estimator.c
+//
+// Onset-interval tempo estimation shared by tap and hands-free tempo
+// capture.
+//
+// See tempo_estimator.h for more information.
+//
+
+#include "tempo_estimator.h"
+
+#include <string.h>
+
+static uint8_t tempo_for_interval( uint32_t interval_ms )
+{
+   uint32_t bpm;
+
+   // Two onsets in the same ms - ignore rather than divide by zero.
+   if( interval_ms == 0 ) {
+      return 0;
+   }
+
+   bpm = 60000 / interval_ms;
+   return ( bpm > 255 ) ? 255 : (uint8_t) bpm;
+}
+
+void tempo_estimator_reset( tempo_estimator* est,
+                            uint32_t first_onset_time )
+{
+   memset( est, 0, sizeof(*est) );
+   est->last_onset_time = first_onset_time;
+}
+
+uint8_t tempo_estimator_add_onset( tempo_estimator* est,
+                                   uint32_t onset_time )
+{
+   uint8_t changed = 0;
+   uint32_t interval = onset_time - est->last_onset_time;
+   est->last_onset_time = onset_time;
+
+   // Push the interval; once the window is full, average it and
+   // slide it along.
+   if( est->num_intervals < TEMPO_EST_MAX_INTERVALS ) {
+      est->intervals[est->num_intervals++] = interval;
+   } else {
+      uint32_t sum = est->intervals[0];
+      for( int i = 1; i < TEMPO_EST_MAX_INTERVALS; i++ ) {
+         sum += est->intervals[i];
+         est->intervals[i-1] = est->intervals[i];
+      }
+      est->intervals[TEMPO_EST_MAX_INTERVALS-1] = interval;
+      est->avg_tempo =
+         tempo_for_interval( sum / TEMPO_EST_MAX_INTERVALS );
+      changed |= TEMPO_EST_AVG_CHANGED;
+   }
+
+   if( est->num_intervals > 1 ) {
+      est->curr_tempo = tempo_for_interval( interval );
+      changed |= TEMPO_EST_CURR_CHANGED;
+   }
+
+   return changed;
+}
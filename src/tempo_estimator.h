@@ -0,0 +1,50 @@
+#ifndef TEMPO_ESTIMATOR_H
+#define TEMPO_ESTIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// tempo_estimator.h
+//
+// Turns a stream of onset timestamps into a "last" and an "average"
+// tempo.  This is the estimator behind the Find Tempo window.  It
+// doesn't care where the onsets come from - a tap on the down button
+// and an onset found in accelerometer data by onset_detector are fed
+// in exactly the same way.
+//
+// Timestamps are in ms (see hw_timer) and may wrap; only differences
+// between consecutive onsets are ever used.
+//
+// To use this:
+//
+// 1.  Call tempo_estimator_reset() with the time of the first onset.
+//
+// 2.  Call tempo_estimator_add_onset() for each following onset.  The
+//     return value tells you which of the two tempos changed, so you
+//     only need to redraw what's new.
+
+#define TEMPO_EST_MAX_INTERVALS (4)
+
+// Return flags of tempo_estimator_add_onset().
+#define TEMPO_EST_CURR_CHANGED (0x01)
+#define TEMPO_EST_AVG_CHANGED (0x02)
+
+typedef struct {
+   uint32_t last_onset_time;
+   uint8_t num_intervals;
+   uint32_t intervals[TEMPO_EST_MAX_INTERVALS];
+
+   // Results, in beats per minute.
+   uint8_t curr_tempo;
+   uint8_t avg_tempo;
+} tempo_estimator;
+
+void tempo_estimator_reset( tempo_estimator* est,
+                            uint32_t first_onset_time );
+
+uint8_t tempo_estimator_add_onset( tempo_estimator* est,
+                                   uint32_t onset_time );
+
+#endif
@@ -8,12 +8,34 @@
 //
 
 #include "timer_stack.h"
+#include "hw_timer.h"
 
 static timer_stack_timeout_handler
 timer_stack_handler_stack[TIMER_STACK_MAX_DEPTH];
 
 static int curr_stack_depth;
 
+// Deadlines of armed timers, freed when they fire or are cancelled.
+// That's at most the beat, a frame, the flash, the tap timeout, a
+// spinner repeat and the stress test's two stand-ins at once; if it
+// does fill up, entries are overwritten in turn.
+#define MAX_PENDING (10)
+
+typedef struct {
+   AppTimerHandle handle;
+   uint32_t deadline;
+   const char* source;
+} pending_timer;
+
+static pending_timer pending[MAX_PENDING];
+static uint8_t next_pending;
+
+static bool measuring;
+static timer_stack_latency latency[TIMER_STACK_MAX_SOURCES];
+static uint8_t num_latency;
+
+static timer_trace* trace;
+
 void timer_stack_init_once( void )
 {
    curr_stack_depth = 0;
@@ -25,7 +47,7 @@ void timer_stack_init_once( void )
 
 bool timer_stack_push( timer_stack_timeout_handler handler )
 {
-   if( curr_stack_depth < ( TIMER_STACK_MAX_DEPTH - 1 ) ) {
+   if( curr_stack_depth < TIMER_STACK_MAX_DEPTH ) {
       timer_stack_handler_stack[curr_stack_depth++] = handler;
       return true;
    }
@@ -36,19 +58,133 @@ bool timer_stack_push( timer_stack_timeout_handler handler )
 bool timer_stack_pop( void )
 {
    if( curr_stack_depth > 0 ) {
-      timer_stack_handler_stack[curr_stack_depth--] = NULL;
+      timer_stack_handler_stack[--curr_stack_depth] = NULL;
       return true;
    }
 
    return false;
 }
 
+AppTimerHandle timer_stack_send_event( AppContextRef app_ctx,
+                                       uint32_t timeout_ms,
+                                       uint32_t cookie,
+                                       const char* source )
+{
+   AppTimerHandle handle = app_timer_send_event( app_ctx,
+                                                 timeout_ms,
+                                                 cookie );
+
+   uint8_t slot = 0;
+
+   while( slot < MAX_PENDING && pending[slot].handle != 0 ) {
+      slot++;
+   }
+   if( slot == MAX_PENDING ) {
+      slot = next_pending;
+      next_pending = ( next_pending + 1 ) % MAX_PENDING;
+   }
+
+   pending[slot].handle = handle;
+   pending[slot].deadline = hw_timer_get_time() + timeout_ms;
+   pending[slot].source = source;
+
+   return handle;
+}
+
+void timer_stack_cancel_event( AppContextRef app_ctx,
+                               AppTimerHandle handle )
+{
+   app_timer_cancel_event( app_ctx, handle );
+
+   for( uint8_t i = 0; i < MAX_PENDING; i++ ) {
+      if( pending[i].handle == handle ) {
+         pending[i].handle = 0;
+      }
+   }
+}
+
+static timer_stack_latency* find_latency( const char* source )
+{
+   for( uint8_t i = 0; i < num_latency; i++ ) {
+      if( latency[i].source == source ) {
+         return &latency[i];
+      }
+   }
+   if( num_latency == TIMER_STACK_MAX_SOURCES ) {
+      return NULL;
+   }
+   latency[num_latency].source = source;
+   latency_hist_reset( &latency[num_latency].hist );
+   return &latency[num_latency++];
+}
+
+void timer_stack_measure_latency( bool enable )
+{
+   measuring = enable;
+   if( enable ) {
+      for( uint8_t i = 0; i < num_latency; i++ ) {
+         latency_hist_reset( &latency[i].hist );
+      }
+   }
+}
+
+uint8_t timer_stack_num_latency( void )
+{
+   return num_latency;
+}
+
+const timer_stack_latency* timer_stack_get_latency( uint8_t index )
+{
+   return ( index < num_latency ) ? &latency[index] : NULL;
+}
+
+void timer_stack_set_trace( timer_trace* new_trace )
+{
+   trace = new_trace;
+}
+
+// Take a timer that just fired out of pending.  It's copied out, as
+// its handler may well arm the next one into the same slot.
+static bool take_pending( AppTimerHandle handle, pending_timer* timer )
+{
+   for( uint8_t i = 0; i < MAX_PENDING; i++ ) {
+      if( pending[i].handle == handle ) {
+         *timer = pending[i];
+         pending[i].handle = 0;
+         return true;
+      }
+   }
+   return false;
+}
+
+static void record_latency( const pending_timer* timer )
+{
+   timer_stack_latency* lat = find_latency( timer->source );
+
+   if( lat ) {
+      latency_hist_add( &lat->hist,
+                        (int32_t) ( hw_timer_get_time() - timer->deadline ) );
+   }
+}
+
 void timer_stack_handle_timeout( AppContextRef app_ctx,
                                  AppTimerHandle handle,
                                  uint32_t cookie )
 {
    bool handler_ret;
    timer_stack_timeout_handler handler;
+   pending_timer timer;
+   bool known = take_pending( handle, &timer );
+   bool timed = known && measuring;
+
+   if( known && trace ) {
+      uint32_t now = hw_timer_get_time();
+
+      timer_trace_timer( trace,
+                         now,
+                         timer.source,
+                         (int32_t) ( now - timer.deadline ) );
+   }
 
    // Bail if the stack is empty.
    if( curr_stack_depth == 0 ) {
@@ -67,6 +203,9 @@ void timer_stack_handle_timeout( AppContextRef app_ctx,
 
       // Handler consumed timeout - we're done.
       if( handler_ret ) {
+         if( timed ) {
+            record_latency( &timer );
+         }
          return;
       }
    }
@@ -3,6 +3,8 @@
 
 #include "pebble_os.h"
 #include "pebble_app.h"
+#include "latency_hist.h"
+#include "timer_trace.h"
 
 ////////////////////////////////////////////////////////////////////////
 //
@@ -78,6 +80,24 @@
 // 2.  return
 //
 // That's it.
+//
+// Latency measurement
+//
+// Arm timers with timer_stack_send_event() instead of
+// app_timer_send_event(), naming what the timer is for, and the stack
+// remembers each timer's deadline until it fires.  Cancel them with
+// timer_stack_cancel_event() so it forgets them then too.  While
+// measuring is on, the time from that deadline until the handler that
+// consumes the timeout returns is added to a histogram for that name.
+// That's the latency the timer's consumer saw - the wait behind
+// whatever else was running, plus its own work - so the tails show
+// who is holding up whom.
+//
+// Tracing
+//
+// Given a timer_trace, the stack also logs how late the OS called it
+// for each timer armed with timer_stack_send_event(), before any
+// handler runs - the OS's part of the latency alone.
 
 // Set this value to increase or decrease the depth of the timer
 // handler stack.  Each entry is only the size of a pointer.
@@ -100,6 +120,38 @@ bool timer_stack_push( timer_stack_timeout_handler handler );
 // this isn't actually an error.
 bool timer_stack_pop();
 
+// app_timer_send_event(), recording the deadline against source, a
+// string that lives forever.  Timers are told apart by the pointer,
+// not the text, so everything arming the same kind of timer should
+// share one string.
+AppTimerHandle timer_stack_send_event( AppContextRef app_ctx,
+                                       uint32_t timeout_ms,
+                                       uint32_t cookie,
+                                       const char* source );
+
+// app_timer_cancel_event(), for a timer armed with
+// timer_stack_send_event().
+void timer_stack_cancel_event( AppContextRef app_ctx,
+                               AppTimerHandle handle );
+
+// Deadline-to-finish latency, per source.
+#define TIMER_STACK_MAX_SOURCES (6)
+
+typedef struct {
+   const char* source;
+   latency_hist hist;
+} timer_stack_latency;
+
+// Turning measuring on clears the histograms.
+void timer_stack_measure_latency( bool enable );
+
+uint8_t timer_stack_num_latency( void );
+
+const timer_stack_latency* timer_stack_get_latency( uint8_t index );
+
+// Log timer fires to trace, or stop with NULL.
+void timer_stack_set_trace( timer_trace* trace );
+
 // This function becomes the app-level timeout handler.  You must set
 // the PebbleAppHandlers .timer_handler to this function in pbl_main()
 // during app initialization.
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////
+//
+// timer_trace.c
+//
+// Timer fire and button log, for replay on the host.
+//
+// See timer_trace.h for more information.
+//
+
+#include "timer_trace.h"
+
+#include <string.h>
+
+static uint16_t get_u16( const uint8_t* p )
+{
+   return p[0] | ( p[1] << 8 );
+}
+
+static void put_u16( uint8_t* p, uint16_t v )
+{
+   p[0] = v & 0xFF;
+   p[1] = v >> 8;
+}
+
+void timer_trace_start( timer_trace* trace,
+                        uint32_t now,
+                        uint8_t tempo,
+                        uint8_t slots,
+                        const char* const* sources,
+                        uint8_t num_sources )
+{
+   memset( trace, 0, sizeof(*trace) );
+   while(    trace->num_sources < num_sources
+          && trace->num_sources < TIMER_TRACE_MAX_SOURCES ) {
+      trace->sources[trace->num_sources] = sources[trace->num_sources];
+      trace->num_sources++;
+   }
+   trace->tempo = tempo;
+   trace->slots = slots;
+   trace->last_time = now;
+   trace->recording = true;
+}
+
+void timer_trace_stop( timer_trace* trace )
+{
+   trace->recording = false;
+}
+
+bool timer_trace_done( const timer_trace* trace )
+{
+   return ! trace->recording && trace->count > 0;
+}
+
+static void add( timer_trace* trace,
+                 uint32_t now,
+                 uint8_t kind,
+                 int32_t late_ms )
+{
+   timer_trace_record* rec;
+   uint32_t dt = now - trace->last_time;
+   bool ext = late_ms > INT8_MAX || late_ms <= TIMER_TRACE_LATE_ESCAPE;
+
+   if( ! trace->recording ) {
+      return;
+   }
+   // Rather than lose the escape's second half.
+   if( ext && trace->count + 2 > TIMER_TRACE_MAX_RECORDS ) {
+      trace->recording = false;
+      return;
+   }
+
+   rec = &trace->records[trace->count++];
+   rec->dt_ms = ( dt > UINT16_MAX ) ? UINT16_MAX : dt;
+   rec->kind = kind;
+   rec->late_ms = ext ? TIMER_TRACE_LATE_ESCAPE : late_ms;
+   trace->last_time = now;
+
+   if( ext ) {
+      rec = &trace->records[trace->count++];
+      rec->dt_ms = (uint16_t) ( ( late_ms > INT16_MAX ) ? INT16_MAX
+                              : ( late_ms < INT16_MIN ) ? INT16_MIN
+                              : late_ms );
+      rec->kind = TIMER_TRACE_LATE_EXT;
+      rec->late_ms = 0;
+   }
+
+   if( trace->count == TIMER_TRACE_MAX_RECORDS ) {
+      trace->recording = false;
+   }
+}
+
+void timer_trace_timer( timer_trace* trace,
+                        uint32_t now,
+                        const char* source,
+                        int32_t late_ms )
+{
+   uint8_t s;
+
+   for( s = 0; s < trace->num_sources; s++ ) {
+      if( trace->sources[s] == source ) {
+         add( trace, now, s, late_ms );
+         return;
+      }
+   }
+}
+
+void timer_trace_button( timer_trace* trace,
+                         uint32_t now,
+                         uint8_t button,
+                         bool down )
+{
+   add( trace,
+        now,
+        ( down ? TIMER_TRACE_BUTTON_DOWN : TIMER_TRACE_BUTTON_UP )
+           | ( button & 0x0F ),
+        0 );
+}
+
+void timer_trace_mark( timer_trace* trace, uint32_t now, uint8_t kind )
+{
+   add( trace, now, kind, 0 );
+}
+
+static uint16_t image_size( const timer_trace* trace )
+{
+   return TIMER_TRACE_HEADER_SIZE + trace->count * TIMER_TRACE_RECORD_SIZE;
+}
+
+// Byte i of the image.  Built a byte at a time so the image never
+// needs a buffer of its own.
+static uint8_t image_byte( const timer_trace* trace, uint16_t i )
+{
+   const timer_trace_record* rec;
+
+   if( i < 8 ) {
+      switch( i ) {
+      case 0: return 'T';
+      case 1: return 'R';
+      case 2: return TIMER_TRACE_VERSION;
+      case 3: return trace->num_sources;
+      case 4: return trace->tempo;
+      case 5: return trace->slots;
+      case 6: return trace->count & 0xFF;
+      default: return trace->count >> 8;
+      }
+   }
+
+   if( i < TIMER_TRACE_HEADER_SIZE ) {
+      uint8_t s = ( i - 8 ) / TIMER_TRACE_NAME_SIZE;
+      uint8_t c = ( i - 8 ) % TIMER_TRACE_NAME_SIZE;
+      const char* name = ( s < trace->num_sources ) ? trace->sources[s]
+                                                    : "";
+
+      // Names are NUL-padded and may fill the field.
+      if( strlen( name ) <= c ) {
+         return 0;
+      }
+      return name[c];
+   }
+
+   i -= TIMER_TRACE_HEADER_SIZE;
+   rec = &trace->records[i / TIMER_TRACE_RECORD_SIZE];
+   switch( i % TIMER_TRACE_RECORD_SIZE ) {
+   case 0: return rec->dt_ms & 0xFF;
+   case 1: return rec->dt_ms >> 8;
+   case 2: return rec->kind;
+   default: return (uint8_t) rec->late_ms;
+   }
+}
+
+uint16_t timer_trace_handle( const timer_trace* trace,
+                             const uint8_t* msg,
+                             uint16_t len,
+                             uint8_t* reply )
+{
+   uint16_t offset;
+   uint16_t total;
+   uint16_t n = 0;
+
+   if( len < TIMER_TRACE_REQUEST_SIZE ) {
+      return 0;
+   }
+   offset = get_u16( msg );
+   total = timer_trace_done( trace ) ? image_size( trace ) : 0;
+
+   put_u16( &reply[0], offset );
+   put_u16( &reply[2], total );
+   while( n < TIMER_TRACE_CHUNK && offset + n < total ) {
+      reply[4 + n] = image_byte( trace, offset + n );
+      n++;
+   }
+
+   return 4 + n;
+}
@@ -0,0 +1,120 @@
+#ifndef TIMER_TRACE_H
+#define TIMER_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////
+//
+// timer_trace.h
+//
+// A compact log of what the OS actually did with our timers - how
+// late each one fired - and of button presses, for replaying on the
+// host (tools/trace_replay.c) against other scheduling policies.
+//
+// Each record is 4 bytes: ms since the previous record, what happened
+// and, for a timer, ms from its deadline to the OS calling us.  A
+// lateness too big for its byte - a stall - is TIMER_TRACE_LATE_ESCAPE
+// there, and the next record, a TIMER_TRACE_LATE_EXT, holds it whole
+// in place of the ms since the previous record.
+//
+// The log fills once and stops; it isn't a ring, as the replay wants
+// an unbroken stretch.  Only timers from the sources given to
+// timer_trace_start() are logged.  With the beat and the pendulum's
+// frames, that's (tempo x slots per beat / 60) + 20 records a second:
+// TIMER_TRACE_MAX_RECORDS is about 20 s at 120 BPM with the metronome
+// window up, and a few minutes with it hidden.
+//
+// The phone reads the finished trace by asking for it a chunk at a
+// time, as a flat little-endian image: an 8-byte header (magic "TR",
+// version, number of sources, tempo, slots per beat, record count),
+// the source names, then the records.
+//
+// To use this:
+//
+// 1.  Call timer_trace_start().  Hand the trace to whatever records
+//     timer fires (see timer_stack_set_trace()), and call
+//     timer_trace_button() and timer_trace_mark() as things happen.
+//
+// 2.  Once timer_trace_done(), answer the phone's requests with
+//     timer_trace_handle().
+
+#define TIMER_TRACE_MAX_RECORDS (512)
+#define TIMER_TRACE_MAX_SOURCES (6)
+#define TIMER_TRACE_NAME_SIZE (8)
+
+#define TIMER_TRACE_VERSION (2)
+#define TIMER_TRACE_HEADER_SIZE \
+   ( 8 + TIMER_TRACE_MAX_SOURCES * TIMER_TRACE_NAME_SIZE )
+#define TIMER_TRACE_RECORD_SIZE (4)
+
+// Record kinds.  Below TIMER_TRACE_MARK, the kind is the index of the
+// timer's source.
+#define TIMER_TRACE_MARK_START (0x40) // beat started
+#define TIMER_TRACE_MARK_STOP (0x41)  // beat stopped
+#define TIMER_TRACE_LATE_EXT (0x42)   // the last timer's whole lateness
+#define TIMER_TRACE_BUTTON_UP (0x80)  // | button id
+#define TIMER_TRACE_BUTTON_DOWN (0x90) // | button id
+
+// Requests are the offset wanted (2 bytes).  Replies are the offset,
+// the image's total size - 0 while still recording - and up to
+// TIMER_TRACE_CHUNK bytes of image.
+#define TIMER_TRACE_REQUEST_SIZE (2)
+#define TIMER_TRACE_CHUNK (40)
+#define TIMER_TRACE_MAX_REPLY (4 + TIMER_TRACE_CHUNK)
+
+#define TIMER_TRACE_LATE_ESCAPE (INT8_MIN)
+
+typedef struct {
+   uint16_t dt_ms;
+   uint8_t kind;
+   int8_t late_ms;
+} timer_trace_record;
+
+typedef struct {
+   // Told apart by pointer, as in timer_stack.
+   const char* sources[TIMER_TRACE_MAX_SOURCES];
+   uint8_t num_sources;
+   uint8_t tempo;
+   uint8_t slots;
+   bool recording;
+   uint32_t last_time;
+   uint16_t count;
+   timer_trace_record records[TIMER_TRACE_MAX_RECORDS];
+} timer_trace;
+
+// tempo and slots (per beat) are what the replay will play.  sources
+// are the timers worth logging, at most TIMER_TRACE_MAX_SOURCES.
+void timer_trace_start( timer_trace* trace,
+                        uint32_t now,
+                        uint8_t tempo,
+                        uint8_t slots,
+                        const char* const* sources,
+                        uint8_t num_sources );
+
+void timer_trace_stop( timer_trace* trace );
+
+bool timer_trace_done( const timer_trace* trace );
+
+// A timer from source fired late_ms after its deadline.  Sources not
+// given to timer_trace_start() are ignored.
+void timer_trace_timer( timer_trace* trace,
+                        uint32_t now,
+                        const char* source,
+                        int32_t late_ms );
+
+void timer_trace_button( timer_trace* trace,
+                         uint32_t now,
+                         uint8_t button,
+                         bool down );
+
+void timer_trace_mark( timer_trace* trace, uint32_t now, uint8_t kind );
+
+// Answer a request for part of the image; returns the reply length,
+// or 0 for a malformed request.
+uint16_t timer_trace_handle( const timer_trace* trace,
+                             const uint8_t* msg,
+                             uint16_t len,
+                             uint8_t* reply );
+
+#endif
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////
+//
+// vibe_synth.c
+//
+// Duty-cycle vibe pattern synthesizer.
+//
+// See vibe_synth.h for more information.
+//
+
+#include "vibe_synth.h"
+
+static void build_level( vibe_synth_level* level,
+                         const vibe_accent_shape* shape,
+                         uint16_t length_ms )
+{
+   uint32_t total = (uint32_t) length_ms * shape->length_pct / 100;
+   uint32_t on = VIBE_SYNTH_CYCLE_MS * shape->duty_pct / 100;
+   uint32_t off = VIBE_SYNTH_CYCLE_MS - on;
+   uint8_t n = 0;
+
+   if( total > VIBE_SYNTH_MAX_MS ) {
+      total = VIBE_SYNTH_MAX_MS;
+   }
+   if( total < VIBE_SYNTH_MIN_SEG_MS ) {
+      total = VIBE_SYNTH_MIN_SEG_MS;
+   }
+   if( on < VIBE_SYNTH_MIN_SEG_MS ) {
+      on = VIBE_SYNTH_MIN_SEG_MS;
+      off = VIBE_SYNTH_CYCLE_MS - on;
+   }
+
+   // Too short an off time can't be felt - that's just a solid buzz.
+   if( off < VIBE_SYNTH_MIN_SEG_MS ) {
+      level->segs[n++] = total;
+   } else {
+      while( total > 0 && n + 2 <= VIBE_SYNTH_MAX_SEGS ) {
+         uint32_t seg = ( on < total ) ? on : total;
+         level->segs[n++] = seg;
+         total -= seg;
+         if( total == 0 ) {
+            break;
+         }
+         // The pattern ends on an on segment long enough to feel,
+         // never on a trailing off or a stub.
+         if( off + VIBE_SYNTH_MIN_SEG_MS > total ) {
+            break;
+         }
+         level->segs[n++] = off;
+         total -= off;
+      }
+   }
+
+   level->pattern.durations = level->segs;
+   level->pattern.num_segments = n;
+}
+
+void vibe_synth_init( vibe_synth* synth, const vibe_accent_shape* shapes )
+{
+   synth->shapes = shapes;
+   synth->built_ms = 0;
+}
+
+void vibe_synth_build( vibe_synth* synth, uint16_t length_ms )
+{
+   if( length_ms == synth->built_ms ) {
+      return;
+   }
+   for( int a = 0; a < VIBE_NUM_ACCENTS; a++ ) {
+      build_level( &synth->levels[a], &synth->shapes[a], length_ms );
+   }
+   synth->built_ms = length_ms;
+}
+
+VibePattern vibe_synth_pattern( const vibe_synth* synth,
+                                vibe_accent accent )
+{
+   return synth->levels[accent].pattern;
+}
@@ -0,0 +1,78 @@
+#ifndef VIBE_SYNTH_H
+#define VIBE_SYNTH_H
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+
+////////////////////////////////////////////////////////////////////////
+//
+// vibe_synth.h
+//
+// Vibe patterns at different strengths.
+//
+// A VibePattern is only on/off durations, and the motor is either on
+// or off, so one solid buzz feels like any other.  A weaker buzz is
+// made the way a dimmer does it: switch the motor on and off in short
+// micro-cycles, on for duty_pct of each one.  The motor never quite
+// spins up or stops between them, and the result feels softer.
+//
+// Each accent level - downbeat, beat, subdivision - has its own duty
+// cycle and length, and its pattern is built once, when the vibe
+// length setting changes.  Beat time only picks a cached pattern.
+//
+// To use this:
+//
+// 1.  Call vibe_synth_build() at init and whenever the vibe length
+//     changes.  It does nothing if the length is unchanged.
+//
+// 2.  At each beat, vibes_enqueue_custom_pattern() the pattern
+//     vibe_synth_pattern() returns for the accent.
+
+typedef enum {
+   VIBE_ACCENT_DOWNBEAT = 0,
+   VIBE_ACCENT_BEAT,
+   VIBE_ACCENT_SUBDIVISION,
+   VIBE_NUM_ACCENTS
+} vibe_accent;
+
+// One on+off micro-cycle.  Much shorter and the motor can't follow;
+// much longer and it's felt as separate taps.
+#define VIBE_SYNTH_CYCLE_MS (16)
+
+// The shortest on or off time the motor responds to.
+#define VIBE_SYNTH_MIN_SEG_MS (4)
+
+#define VIBE_SYNTH_MAX_MS (200)
+#define VIBE_SYNTH_MAX_SEGS \
+   ( 2 * ( VIBE_SYNTH_MAX_MS / VIBE_SYNTH_CYCLE_MS + 1 ) )
+
+typedef struct {
+   // Percent of each micro-cycle the motor is on; 100 is one solid
+   // buzz.
+   uint8_t duty_pct;
+   // Percent of the vibe length setting this accent lasts.
+   uint8_t length_pct;
+} vibe_accent_shape;
+
+typedef struct {
+   uint32_t segs[VIBE_SYNTH_MAX_SEGS];
+   VibePattern pattern;
+} vibe_synth_level;
+
+typedef struct {
+   const vibe_accent_shape* shapes;
+
+   // Don't touch!!
+   uint16_t built_ms;
+   vibe_synth_level levels[VIBE_NUM_ACCENTS];
+} vibe_synth;
+
+// shapes has VIBE_NUM_ACCENTS entries, and must outlive synth.
+void vibe_synth_init( vibe_synth* synth, const vibe_accent_shape* shapes );
+
+void vibe_synth_build( vibe_synth* synth, uint16_t length_ms );
+
+VibePattern vibe_synth_pattern( const vibe_synth* synth,
+                                vibe_accent accent );
+
+#endif
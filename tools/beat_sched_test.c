@@ -0,0 +1,248 @@
+////////////////////////////////////////////////////////////////////////
+//
+// beat_sched_test.c
+//
+// Checks src/beat_sched.c's recovery from a stalled timer.  A beat
+// engine in miniature - the same drop, shift and play steps as
+// beat_engine.c's beat() - runs a 500 ms grid while the OS fires
+// nothing for STALL_MS, and the beats each recovery plays are
+// compared with what beat_sched.h says it does.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o beat_sched_test tools/beat_sched_test.c src/beat_sched.c
+//    ./beat_sched_test
+//
+// Every failed check is printed, and the exit status is non-zero if
+// there were any.
+//
+
+#include "beat_sched.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SLOT_MS (500)
+#define RUN_MS (5000)
+
+// Slot 4, due at 2000, doesn't fire until 3200.
+#define STALL_AT_MS (2000)
+#define STALL_MS (1200)
+
+#define MAX_PLAYED (32)
+
+typedef struct {
+   uint32_t time[MAX_PLAYED];
+   uint32_t slot[MAX_PLAYED];
+   int n;
+   beat_sched_stats stats;
+} outcome;
+
+static int failures;
+
+static void expect( bool ok, const char* test, const char* what )
+{
+   if( ! ok ) {
+      printf( "FAIL: %s: %s\n", test, what );
+      failures++;
+   }
+}
+
+static void play( outcome* out, uint32_t now, uint32_t slot )
+{
+   if( out->n < MAX_PLAYED ) {
+      out->time[out->n] = now;
+      out->slot[out->n] = slot;
+      out->n++;
+   }
+}
+
+// Run the grid from 0 to RUN_MS, the OS firing every timer late_ms
+// after it's due and nothing at all during the stall.
+static void run( beat_sched_policy policy,
+                 beat_sched_recovery recovery,
+                 uint32_t stall_ms,
+                 uint32_t late_ms,
+                 outcome* out )
+{
+   beat_sched sched;
+   uint32_t now = 0;
+   uint32_t slot = 0;
+   uint32_t shifted = 0;
+
+   memset( out, 0, sizeof(*out) );
+   beat_sched_init( &sched, policy, 0 );
+   beat_sched_set_recovery( &sched, recovery );
+   beat_sched_set_slot_ms( &sched, SLOT_MS );
+   beat_sched_start( &sched, now );
+
+   // Starting plays the first beat there and then.
+   beat_sched_played( &sched, now );
+   play( out, now, slot++ );
+
+   for( ;; ) {
+      uint32_t fire = now
+                      + beat_sched_delay( &sched,
+                                          slot * SLOT_MS + shifted,
+                                          now )
+                      + late_ms;
+      int32_t shift_ms;
+      bool dropped = false;
+
+      if( fire >= STALL_AT_MS && fire < STALL_AT_MS + stall_ms ) {
+         fire = STALL_AT_MS + stall_ms;
+      }
+      if( fire >= RUN_MS ) {
+         break;
+      }
+      now = fire;
+      if(    beat_sched_fired( &sched, slot * SLOT_MS + shifted, now )
+          != BEAT_SCHED_BEAT ) {
+         continue;
+      }
+
+      while(    beat_sched_check( &sched,
+                                  slot * SLOT_MS + shifted,
+                                  now,
+                                  &shift_ms )
+             == BEAT_SCHED_DROP ) {
+         slot++;
+         dropped = true;
+      }
+      shifted += shift_ms;
+      if( dropped && (int32_t) ( slot * SLOT_MS + shifted - now ) > 0 ) {
+         continue;
+      }
+
+      beat_sched_played( &sched, now );
+      play( out, now, slot++ );
+   }
+   out->stats = sched.stats;
+}
+
+static bool played_at( const outcome* out, uint32_t slot, uint32_t time )
+{
+   for( int i = 0; i < out->n; i++ ) {
+      if( out->slot[i] == slot ) {
+         return out->time[i] == time;
+      }
+   }
+   return false;
+}
+
+static bool played( const outcome* out, uint32_t slot )
+{
+   for( int i = 0; i < out->n; i++ ) {
+      if( out->slot[i] == slot ) {
+         return true;
+      }
+   }
+   return false;
+}
+
+// Drops the beats the stall swallowed, and carries on from the next
+// grid point still to come: slots 4-6 go, 7 is on time.
+static void test_skip( void )
+{
+   const char* test = "skip";
+   outcome out;
+
+   run( BEAT_SCHED_ABSOLUTE, BEAT_SCHED_SKIP, STALL_MS, 0, &out );
+
+   expect( out.n == 7, test, "7 beats played" );
+   expect(    played_at( &out, 3, 1500 )
+           && ! played( &out, 4 )
+           && ! played( &out, 5 )
+           && ! played( &out, 6 ),
+           test, "slots 4-6 dropped" );
+   expect( played_at( &out, 7, 3500 ), test, "slot 7 on its grid point" );
+   expect( played_at( &out, 9, 4500 ), test, "slot 9 on its grid point" );
+   expect( out.stats.misses == 3, test, "3 misses" );
+   expect( out.stats.dropped == 3, test, "3 dropped" );
+   expect( out.stats.max_late_ms == STALL_MS, test, "worst is the stall" );
+}
+
+// Plays the missed beat when the stall ends, then the rest at half
+// spacing until they're back on the grid.
+static void test_catch_up( void )
+{
+   const char* test = "catch-up";
+   uint32_t half = SLOT_MS * BEAT_SCHED_CATCH_UP_PCT / 100;
+   outcome out;
+
+   run( BEAT_SCHED_ABSOLUTE, BEAT_SCHED_CATCH_UP, STALL_MS, 0, &out );
+
+   expect( out.n == 10, test, "every slot played" );
+   expect( played_at( &out, 4, STALL_AT_MS + STALL_MS ),
+           test, "slot 4 at the end of the stall" );
+   expect( played_at( &out, 5, STALL_AT_MS + STALL_MS + half ),
+           test, "slot 5 half a slot later" );
+   expect( played_at( &out, 8, STALL_AT_MS + STALL_MS + 4 * half ),
+           test, "slot 8 four half slots later" );
+   expect( played_at( &out, 9, 4500 ), test, "back on the grid by slot 9" );
+   for( int i = 1; i < out.n; i++ ) {
+      expect( out.time[i] - out.time[i - 1] >= half,
+              test, "no two beats closer than half a slot" );
+   }
+   expect( out.stats.misses == 1, test, "1 miss" );
+   expect( out.stats.dropped == 0, test, "none dropped" );
+   expect( out.stats.shifted_ms == 0, test, "grid not shifted" );
+}
+
+// Plays the missed beat when the stall ends and moves the grid along
+// by the stall.
+static void test_shift( void )
+{
+   const char* test = "shift";
+   outcome out;
+
+   run( BEAT_SCHED_ABSOLUTE, BEAT_SCHED_SHIFT, STALL_MS, 0, &out );
+
+   expect( out.n == 8, test, "8 beats played" );
+   expect( played_at( &out, 4, STALL_AT_MS + STALL_MS ),
+           test, "slot 4 at the end of the stall" );
+   expect( played_at( &out, 5, 2500 + STALL_MS ),
+           test, "slot 5 a slot after it" );
+   expect( played_at( &out, 7, 3500 + STALL_MS ),
+           test, "slot 7 on the shifted grid" );
+   expect( out.stats.misses == 1, test, "1 miss" );
+   expect( out.stats.dropped == 0, test, "none dropped" );
+   expect( out.stats.shifted_ms == STALL_MS, test, "shifted by the stall" );
+}
+
+// RELATIVE drifts by design.  Steadily late timers are no miss, and a
+// stall is counted but never dropped.
+static void test_relative( void )
+{
+   const char* test = "relative";
+   outcome out;
+
+   run( BEAT_SCHED_RELATIVE, BEAT_SCHED_SKIP, 0, 10, &out );
+
+   expect( out.n == 10, test, "10 beats played" );
+   expect( played_at( &out, 9, 9 * ( SLOT_MS + 10 ) ),
+           test, "lateness carried forward" );
+   expect( out.stats.misses == 0, test, "no misses on a clean run" );
+
+   run( BEAT_SCHED_RELATIVE, BEAT_SCHED_SKIP, STALL_MS, 0, &out );
+
+   expect( out.stats.misses == 1, test, "the stall is a miss" );
+   expect( out.stats.dropped == 0, test, "none dropped" );
+   expect( played_at( &out, 4, STALL_AT_MS + STALL_MS ),
+           test, "slot 4 at the end of the stall" );
+}
+
+int main( void )
+{
+   test_skip();
+   test_catch_up();
+   test_shift();
+   test_relative();
+
+   if( failures > 0 ) {
+      printf( "%d failed\n", failures );
+      return 1;
+   }
+   printf( "all passed\n" );
+   return 0;
+}
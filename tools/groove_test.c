@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////
+//
+// groove_test.c
+//
+// Checks that src/groove.c keeps a beat's slots in order, whatever
+// the template.  beat_engine.c plays the slots in index order, so a
+// slot built before the one ahead of it would fire late and count as
+// a miss.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o groove_test tools/groove_test.c src/groove.c
+//    ./groove_test
+//
+// Every failed check is printed, and the exit status is non-zero if
+// there were any.
+//
+
+#include "groove.h"
+
+#include <stdio.h>
+
+static const uint8_t tempos[] = { 30, 60, 120, 200, 255 };
+static const int8_t customs[] = { -GROOVE_MAX_CUSTOM_PCT, 0,
+                                  GROOVE_MAX_CUSTOM_PCT };
+static const int8_t shifts[] = { -GROOVE_MAX_SHIFT_MS, 0,
+                                 GROOVE_MAX_SHIFT_MS };
+
+#define NUM(a) ( sizeof(a) / sizeof((a)[0]) )
+
+static int failures;
+static int checked;
+
+// Each slot at least the minimum gap after the one before, and the
+// last that far before the next beat's first.
+static bool in_order( const groove_table* tab )
+{
+   int32_t gap_q8 = ( tab->interval_q8 / tab->num_slots )
+                    * GROOVE_MIN_GAP_PCT / 100;
+
+   for( int s = 1; s < tab->num_slots; s++ ) {
+      if( tab->slot_offset_q8[s] - tab->slot_offset_q8[s - 1] < gap_q8 ) {
+         return false;
+      }
+   }
+   return    tab->slot_offset_q8[0] + (int32_t) tab->interval_q8
+           - tab->slot_offset_q8[tab->num_slots - 1]
+          >= gap_q8;
+}
+
+static void check( const groove_template* tmpl, uint8_t tempo )
+{
+   groove_table tab;
+
+   groove_build( &tab, tmpl, tempo );
+   checked++;
+   if( ! in_order( &tab ) ) {
+      printf( "FAIL: %u subdivisions, swing %u, custom %d %d %d %d,"
+              " shift %d, %u bpm:",
+              tmpl->subdivisions, tmpl->swing_pct,
+              tmpl->custom_pct[0], tmpl->custom_pct[1],
+              tmpl->custom_pct[2], tmpl->custom_pct[3],
+              tmpl->shift_ms, tempo );
+      for( int s = 0; s < tab.num_slots; s++ ) {
+         printf( " %ld", (long) ( tab.slot_offset_q8[s] >> 8 ) );
+      }
+      printf( " ms\n" );
+      failures++;
+   }
+}
+
+// Slot 1 pushed half a subdivision late and slot 2 half early, on a
+// dotted-eighth shuffle, would put slot 2 before slot 1.
+static void test_crossed_slots( void )
+{
+   groove_template tmpl;
+   groove_table tab;
+
+   groove_template_init( &tmpl );
+   tmpl.subdivisions = 4;
+   tmpl.swing_pct = 75;
+   tmpl.custom_pct[1] = 50;
+   tmpl.custom_pct[2] = -50;
+   check( &tmpl, 120 );
+
+   groove_build( &tab, &tmpl, 120 );
+   if( tab.slot_offset_q8[1] >> 8 != 250 ) {
+      printf( "FAIL: slot 1 moved from 250 ms to %ld\n",
+              (long) ( tab.slot_offset_q8[1] >> 8 ) );
+      failures++;
+   }
+}
+
+// A straight groove is untouched.
+static void test_straight( void )
+{
+   groove_template tmpl;
+   groove_table tab;
+
+   groove_template_init( &tmpl );
+   tmpl.subdivisions = 4;
+   groove_build( &tab, &tmpl, 120 );
+   for( int s = 0; s < 4; s++ ) {
+      if( tab.slot_offset_q8[s] != s * ( (int32_t) tab.interval_q8 / 4 ) ) {
+         printf( "FAIL: straight slot %d at %ld ms\n",
+                 s, (long) ( tab.slot_offset_q8[s] >> 8 ) );
+         failures++;
+      }
+   }
+}
+
+// Every combination of the extremes.
+static void test_all( void )
+{
+   groove_template tmpl;
+
+   groove_template_init( &tmpl );
+   for( uint8_t subdivs = 1; subdivs <= GROOVE_MAX_SLOTS; subdivs++ )
+   for( uint8_t swing = GROOVE_MIN_SWING_PCT;
+        swing <= GROOVE_MAX_SWING_PCT;
+        swing += 5 )
+   for( unsigned c0 = 0; c0 < NUM(customs); c0++ )
+   for( unsigned c1 = 0; c1 < NUM(customs); c1++ )
+   for( unsigned c2 = 0; c2 < NUM(customs); c2++ )
+   for( unsigned c3 = 0; c3 < NUM(customs); c3++ )
+   for( unsigned sh = 0; sh < NUM(shifts); sh++ )
+   for( unsigned t = 0; t < NUM(tempos); t++ ) {
+      tmpl.subdivisions = subdivs;
+      tmpl.swing_pct = swing;
+      tmpl.custom_pct[0] = customs[c0];
+      tmpl.custom_pct[1] = customs[c1];
+      tmpl.custom_pct[2] = customs[c2];
+      tmpl.custom_pct[3] = customs[c3];
+      tmpl.shift_ms = shifts[sh];
+      check( &tmpl, tempos[t] );
+   }
+}
+
+int main( void )
+{
+   test_crossed_slots();
+   test_straight();
+   test_all();
+
+   if( failures > 0 ) {
+      printf( "%d of %d failed\n", failures, checked );
+      return 1;
+   }
+   printf( "all %d passed\n", checked );
+   return 0;
+}
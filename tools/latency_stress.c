@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////
+//
+// latency_stress.c
+//
+// Host model of the event storm (src/event_storm.c).  The watch runs
+// one event loop: a timer whose deadline has passed waits until
+// whatever is running finishes, then runs for its work_us.  This
+// plays the storm through such a loop and reports, per source, the
+// distribution of time from each deadline to its handler finishing -
+// the same numbers the watch's Stress Test shows.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o latency_stress tools/latency_stress.c
+//       src/event_storm.c src/latency_hist.c    (one line)
+//    ./latency_stress [work_pct] [seconds]
+//
+// work_pct scales every handler's work (default 100) to ask what
+// happens when a consumer gets slower.
+//
+
+#include "event_storm.h"
+#include "latency_hist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main( int argc, char** argv )
+{
+   int work_pct = ( argc > 1 ) ? atoi( argv[1] ) : 100;
+   int seconds = ( argc > 2 ) ? atoi( argv[2] )
+                              : EVENT_STORM_DURATION_MS / 1000;
+   event_storm storm;
+   latency_hist hist[EVENT_STORM_NUM_SOURCES];
+   uint64_t due_us[EVENT_STORM_NUM_SOURCES];
+   uint64_t now_us = 0;
+   uint64_t end_us = (uint64_t) seconds * 1000000;
+
+   event_storm_start( &storm, 0 );
+   for( int s = 0; s < EVENT_STORM_NUM_SOURCES; s++ ) {
+      latency_hist_reset( &hist[s] );
+      due_us[s] = (uint64_t) event_storm_next( &storm, s ) * 1000;
+   }
+
+   while( now_us < end_us ) {
+      // Timers fire in deadline order; ties go to the table order.
+      int next = 0;
+      uint64_t finish_us;
+
+      for( int s = 1; s < EVENT_STORM_NUM_SOURCES; s++ ) {
+         if( due_us[s] < due_us[next] ) {
+            next = s;
+         }
+      }
+      if( due_us[next] > now_us ) {
+         now_us = due_us[next];
+      }
+
+      finish_us = now_us
+         + (uint64_t) event_storm_sources[next].work_us * work_pct / 100;
+      // Round up: a handler 0.2 ms late is reported 1 ms late.
+      latency_hist_add( &hist[next],
+                        (int32_t) ( ( finish_us - due_us[next] + 999 )
+                                    / 1000 ) );
+      now_us = finish_us;
+      due_us[next] = (uint64_t) event_storm_next( &storm, next ) * 1000;
+   }
+
+   printf( "%d s storm, work at %d%%\n", seconds, work_pct );
+   printf( "source   events  p50  p99  max (ms, deadline to finish)\n" );
+   for( int s = 0; s < EVENT_STORM_NUM_SOURCES; s++ ) {
+      printf( "%-6s %8lu %4u %4u %4u\n",
+              event_storm_sources[s].name,
+              (unsigned long) hist[s].total,
+              latency_hist_percentile( &hist[s], 50 ),
+              latency_hist_percentile( &hist[s], 99 ),
+              hist[s].max_ms );
+   }
+   return 0;
+}
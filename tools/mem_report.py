@@ -0,0 +1,157 @@
+#!/usr/bin/env python
+#
+# mem_report.py
+#
+# Lists the size of every global object in the app's object files and
+# checks the static RAM total against a budget.  Run it after ./waf
+# build:
+#
+#    python tools/mem_report.py [--budget BYTES] [--nm NM] [--update]
+#                               [objects...]
+#
+# With no objects, it reads every object file under build/src.  RAM is
+# .data and .bss (nm types d, b and common symbols); read-only data
+# lives in flash and is listed separately.  Exits non-zero if RAM is
+# over budget, so a new feature can be checked before it ships.
+#
+# --update also writes the totals into src/mem_report.h, for the app's
+# Diagnostics window to show; build again to pick them up.
+#
+# The same works for a host build of the Pebble-independent modules -
+# pass --nm nm and the host object files.
+#
+# The AppMessage buffers aren't globals - the OS takes them from the
+# app's heap when the app opens AppMessage - so they're read from
+# src/phone_link.h and added to the total as a line of their own.
+#
+# The stack is measured on the watch instead; see src/mem_diag.h.
+
+import argparse
+import glob
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DEFAULT_NM = 'arm-none-eabi-nm'
+DEFAULT_BUDGET = 8192
+HEADER = os.path.join(ROOT, 'src', 'mem_report.h')
+PHONE_LINK = os.path.join(ROOT, 'src', 'phone_link.h')
+# As many files as fit on the Diagnostics page.
+HEADER_FILES = 4
+
+RAM_TYPES = 'bBdDcC'
+FLASH_TYPES = 'rR'
+
+
+def symbols(nm, path):
+    out = subprocess.check_output([nm, '--print-size', '--radix=d', path])
+    for line in out.decode('ascii', 'replace').splitlines():
+        fields = line.split()
+        # value size type name - symbols without a size are skipped
+        if len(fields) != 4:
+            continue
+        size, kind, name = int(fields[1]), fields[2], fields[3]
+        if kind in RAM_TYPES:
+            yield name, size, 'ram'
+        elif kind in FLASH_TYPES:
+            yield name, size, 'flash'
+
+
+def source_name(path):
+    # waf names objects like metronome.c.1.o
+    name = os.path.basename(path)
+    return name.split('.c.')[0] + '.c' if '.c.' in name else name
+
+
+def app_message_buffers():
+    # The #defines are plain sums of numbers and each other.
+    defines = {}
+    with open(PHONE_LINK) as f:
+        for line in f:
+            fields = line.split(None, 2)
+            if len(fields) == 3 and fields[0] == '#define':
+                defines[fields[1]] = fields[2].strip()
+
+    def value(name):
+        total = 0
+        for term in defines[name].strip('()').split('+'):
+            term = term.strip()
+            total += int(term) if term.isdigit() else value(term)
+        return total
+
+    return (value('PHONE_LINK_INBOUND_SIZE'),
+            value('PHONE_LINK_OUTBOUND_SIZE'))
+
+
+def update_header(budget, ram, flash, files):
+    with open(HEADER) as f:
+        text = f.read()
+    top = sorted(files, key=lambda f: -f[1])[:HEADER_FILES]
+    lines = ''.join('%-14s %5d\\n' % (name, size) for name, size in top)
+    values = {
+        'MEM_REPORT_BUDGET': '(%d)' % budget,
+        'MEM_REPORT_RAM': '(%d)' % ram,
+        'MEM_REPORT_FLASH': '(%d)' % flash,
+        'MEM_REPORT_FILES': '"%s"' % lines,
+    }
+    out = []
+    for line in text.splitlines():
+        fields = line.split(None, 2)
+        if len(fields) == 3 and fields[0] == '#define' \
+                and fields[1] in values:
+            line = '#define %s %s' % (fields[1], values[fields[1]])
+        out.append(line)
+    with open(HEADER, 'w') as f:
+        f.write('\n'.join(out) + '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--budget', type=int, default=DEFAULT_BUDGET,
+                        help='static RAM budget in bytes (default %d)'
+                        % DEFAULT_BUDGET)
+    parser.add_argument('--nm', default=DEFAULT_NM)
+    parser.add_argument('--update', action='store_true',
+                        help='write the totals into src/mem_report.h')
+    parser.add_argument('objects', nargs='*')
+    args = parser.parse_args()
+
+    objects = args.objects or sorted(
+        glob.glob(os.path.join(ROOT, 'build', 'src', '*.o')))
+    if not objects:
+        sys.stderr.write('no object files - run ./waf build first\n')
+        return 1
+
+    totals = {'ram': 0, 'flash': 0}
+    files = []
+    for path in objects:
+        syms = sorted(symbols(args.nm, path), key=lambda s: -s[1])
+        ram = sum(s[1] for s in syms if s[2] == 'ram')
+        flash = sum(s[1] for s in syms if s[2] == 'flash')
+        totals['ram'] += ram
+        totals['flash'] += flash
+        files.append((source_name(path), ram))
+        print('%-20s %6d B RAM %6d B flash' % (source_name(path), ram, flash))
+        for name, size, where in syms:
+            print('    %-32s %6d %s' % (name, size, where))
+
+    inbound, outbound = app_message_buffers()
+    totals['ram'] += inbound + outbound
+    print('%-20s %6d B RAM (app heap: %d B in, %d B out)'
+          % ('AppMessage', inbound + outbound, inbound, outbound))
+
+    print('')
+    print('total RAM          %6d B of %d B budget' % (totals['ram'],
+                                                       args.budget))
+    print('total const data   %6d B' % totals['flash'])
+    if args.update:
+        update_header(args.budget, totals['ram'], totals['flash'], files)
+    if totals['ram'] > args.budget:
+        print('OVER BUDGET by %d B' % (totals['ram'] - args.budget))
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,137 @@
+#!/usr/bin/env python
+#
+# mklibrary.py
+#
+# Converts the text description of the pattern library and setlists
+# (resources/src/library.txt) into the compact binary resource the
+# watch streams from (resources/src/data/library.bin).  See
+# src/library.h for the binary format.
+#
+# Run this whenever library.txt changes, before ./waf build:
+#
+#    python tools/mklibrary.py
+#
+# Text format - one directive per line, '#' starts a comment:
+#
+#    song "Name"
+#      section <tempo> <beats>/<unit> [bars=N] [subdiv=N] [swing=N] [shift=N]
+#      ...
+#    setlist "Name"
+#      "Song Name" "Another Song" ...
+#
+# A song is played section by section; bars=0 (the default) repeats
+# a section forever.
+
+import os
+import shlex
+import struct
+import sys
+
+MAGIC = b'PBNL'
+VERSION = 1
+HEADER = struct.Struct('<4sBBHHH')
+SECTION = struct.Struct('<BBBBBBbB')
+MAX_NAME = 15
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SRC = os.path.join(ROOT, 'resources', 'src', 'library.txt')
+DST = os.path.join(ROOT, 'resources', 'src', 'data', 'library.bin')
+
+
+def fail(lineno, msg):
+    sys.stderr.write('library.txt:%d: %s\n' % (lineno, msg))
+    sys.exit(1)
+
+
+def parse(path):
+    songs = []
+    setlists = []
+    current = None
+    for lineno, line in enumerate(open(path), 1):
+        line = line.split('#', 1)[0].strip()
+        if not line:
+            continue
+        words = shlex.split(line)
+        if words[0] in ('song', 'setlist'):
+            if len(words) != 2 or len(words[1]) > MAX_NAME:
+                fail(lineno, 'expected %s "Name" (at most %d chars)'
+                     % (words[0], MAX_NAME))
+            current = {'name': words[1], 'items': [], 'line': lineno}
+            (songs if words[0] == 'song' else setlists).append(current)
+            current['kind'] = words[0]
+        elif words[0] == 'section':
+            if current is None or current['kind'] != 'song':
+                fail(lineno, 'section outside a song')
+            try:
+                tempo = int(words[1])
+                beats, unit = [int(v) for v in words[2].split('/')]
+                opts = dict(w.split('=') for w in words[3:])
+                sec = (tempo, beats, unit,
+                       int(opts.pop('bars', 0)),
+                       int(opts.pop('subdiv', 1)),
+                       int(opts.pop('swing', 50)),
+                       int(opts.pop('shift', 0)),
+                       0)
+            except (IndexError, ValueError):
+                fail(lineno, 'expected section <tempo> <beats>/<unit> ...')
+            if opts:
+                fail(lineno, 'unknown option(s) %s' % ', '.join(opts))
+            if not (1 <= tempo <= 255 and 1 <= beats <= 32
+                    and 1 <= sec[4] <= 4 and 50 <= sec[5] <= 75
+                    and -30 <= sec[6] <= 30 and 0 <= sec[3] <= 255):
+                fail(lineno, 'section value out of range')
+            current['items'].append(sec)
+        elif current is not None and current['kind'] == 'setlist':
+            current['items'].extend(words)
+        else:
+            fail(lineno, 'unexpected "%s"' % words[0])
+    return songs, setlists
+
+
+def name_bytes(name):
+    data = name.encode('ascii')
+    return struct.pack('<B', len(data)) + data
+
+
+def build(songs, setlists):
+    index = dict((s['name'], i) for i, s in enumerate(songs))
+    records = []
+    for song in songs:
+        if not song['items']:
+            fail(song['line'], 'song "%s" has no sections' % song['name'])
+        rec = name_bytes(song['name'])
+        rec += struct.pack('<B', len(song['items']))
+        for sec in song['items']:
+            rec += SECTION.pack(*sec)
+        records.append(rec)
+    for setlist in setlists:
+        rec = name_bytes(setlist['name'])
+        rec += struct.pack('<B', len(setlist['items']))
+        for item in setlist['items']:
+            if item not in index:
+                fail(setlist['line'], 'no song called "%s"' % item)
+            rec += struct.pack('<H', index[item])
+        records.append(rec)
+
+    out = HEADER.pack(MAGIC, VERSION, 0, len(songs), len(setlists), 0)
+    offset = len(out) + 4 * len(records)
+    offsets = []
+    for rec in records:
+        offsets.append(offset)
+        offset += len(rec)
+    out += struct.pack('<%dI' % len(offsets), *offsets)
+    return out + b''.join(records)
+
+
+def main():
+    songs, setlists = parse(SRC)
+    data = build(songs, setlists)
+    with open(DST, 'wb') as f:
+        f.write(data)
+    print('%s: %d songs, %d setlists, %d bytes'
+          % (os.path.relpath(DST, ROOT), len(songs), len(setlists),
+             len(data)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,205 @@
+////////////////////////////////////////////////////////////////////////
+//
+// onset_replay.c
+//
+// Host replay of accelerometer traces through src/onset_detector.c
+// and src/tempo_estimator.c, the way Find Tempo feeds them: batches of
+// at most ONSET_MAX_BATCH samples, the first onset starting a
+// measurement, each later one added to it, and STOP_MEASURING_MS
+// without an onset ending it.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o onset_replay tools/onset_replay.c src/onset_detector.c src/tempo_estimator.c
+//    ./onset_replay trace.txt [rate_hz] [expect_bpm]
+//    ./onset_replay --synth bpm [seconds] [rate_hz]
+//
+// A trace is one sample per line, "x y z" in mg (commas are fine too);
+// lines starting with # are skipped.  --synth makes one instead: a
+// still wrist with a little noise, tapped on every beat from 500 ms
+// in.
+//
+// Every onset and the tempos are printed.  Given a tempo to expect
+// (--synth always has one), it exits non-zero if the average tempo
+// isn't within EXPECT_TOLERANCE_BPM of it, or if there was an onset
+// before the first tap.
+//
+
+#include "onset_detector.h"
+#include "tempo_estimator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SAMPLES (100000)
+#define STOP_MEASURING_MS (2000)
+#define EXPECT_TOLERANCE_BPM (3)
+#define SYNTH_FIRST_TAP_MS (500)
+
+static onset_sample samples[MAX_SAMPLES];
+static uint32_t num_samples;
+
+static tempo_estimator est;
+static int measuring;
+static uint32_t last_onset;
+static uint32_t first_onset;
+static uint32_t num_onsets;
+
+static void handle_onset( uint32_t onset_time, void* context )
+{
+   (void) context;
+
+   if( measuring && onset_time - last_onset >= STOP_MEASURING_MS ) {
+      printf( "%8lu  (measurement timed out)\n",
+              (unsigned long) last_onset + STOP_MEASURING_MS );
+      measuring = 0;
+   }
+
+   if( num_onsets++ == 0 ) {
+      first_onset = onset_time;
+   }
+   if( measuring ) {
+      tempo_estimator_add_onset( &est, onset_time );
+      printf( "%8lu  onset  last %3u  avg %3u bpm\n",
+              (unsigned long) onset_time, est.curr_tempo, est.avg_tempo );
+   } else {
+      tempo_estimator_reset( &est, onset_time );
+      measuring = 1;
+      printf( "%8lu  onset  (measuring)\n", (unsigned long) onset_time );
+   }
+   last_onset = onset_time;
+}
+
+static int load( const char* path )
+{
+   FILE* f = fopen( path, "r" );
+   char line[128];
+
+   if( f == NULL ) {
+      perror( path );
+      return 0;
+   }
+   while( fgets( line, sizeof(line), f ) && num_samples < MAX_SAMPLES ) {
+      int x, y, z;
+
+      if( line[0] == '#' ) {
+         continue;
+      }
+      for( char* c = line; *c; c++ ) {
+         if( *c == ',' ) {
+            *c = ' ';
+         }
+      }
+      if( sscanf( line, "%d %d %d", &x, &y, &z ) == 3 ) {
+         samples[num_samples].x = (int16_t) x;
+         samples[num_samples].y = (int16_t) y;
+         samples[num_samples].z = (int16_t) z;
+         num_samples++;
+      }
+   }
+   fclose( f );
+   return 1;
+}
+
+static int noise( int amplitude )
+{
+   return ( rand() % ( 2 * amplitude + 1 ) ) - amplitude;
+}
+
+// A wrist held still and tilted, so gravity is spread over all three
+// axes, and tapped on each beat: each tap is a sharp kick and rebound
+// on z that dies away over a few samples.
+static void synth( int bpm, int seconds, int rate_hz )
+{
+   static const int tap_mg[] = { -2500, 1500, -800, 400, -150 };
+   uint32_t beat_ms = 60000 / bpm;
+
+   num_samples = (uint32_t) seconds * rate_hz;
+   if( num_samples > MAX_SAMPLES ) {
+      num_samples = MAX_SAMPLES;
+   }
+   for( uint32_t i = 0; i < num_samples; i++ ) {
+      uint32_t t = i * 1000 / rate_hz;
+      int z = -620 + noise( 20 );
+
+      if( t >= SYNTH_FIRST_TAP_MS ) {
+         uint32_t since = ( t - SYNTH_FIRST_TAP_MS ) % beat_ms;
+         uint32_t k = since * rate_hz / 1000;
+
+         if( k < sizeof(tap_mg) / sizeof(tap_mg[0]) ) {
+            z += tap_mg[k];
+         }
+      }
+      samples[i].x = (int16_t) ( 600 + noise( 20 ) );
+      samples[i].y = (int16_t) ( -500 + noise( 20 ) );
+      samples[i].z = (int16_t) z;
+   }
+}
+
+int main( int argc, char** argv )
+{
+   onset_detector det;
+   int rate_hz = 50;
+   int expect_bpm = 0;
+   int first_tap_ms = 0;
+   int failed = 0;
+
+   if( argc >= 3 && strcmp( argv[1], "--synth" ) == 0 ) {
+      int seconds = ( argc > 3 ) ? atoi( argv[3] ) : 10;
+
+      expect_bpm = atoi( argv[2] );
+      if( argc > 4 ) rate_hz = atoi( argv[4] );
+      if( expect_bpm <= 0 || seconds <= 0 || rate_hz <= 0 ) {
+         fprintf( stderr, "bad --synth arguments\n" );
+         return 2;
+      }
+      srand( 1 );
+      synth( expect_bpm, seconds, rate_hz );
+      first_tap_ms = SYNTH_FIRST_TAP_MS;
+   } else if( argc >= 2 ) {
+      if( argc > 2 ) rate_hz = atoi( argv[2] );
+      if( argc > 3 ) expect_bpm = atoi( argv[3] );
+      if( rate_hz <= 0 || ! load( argv[1] ) ) {
+         return 2;
+      }
+   } else {
+      fprintf( stderr,
+               "usage: %s trace.txt [rate_hz] [expect_bpm]\n"
+               "       %s --synth bpm [seconds] [rate_hz]\n",
+               argv[0], argv[0] );
+      return 2;
+   }
+
+   onset_detector_init( &det, (uint16_t) rate_hz, &handle_onset, NULL );
+
+   // As the app gets them: whole batches, timestamped from the first
+   // sample.
+   for( uint32_t i = 0; i < num_samples; ) {
+      uint32_t left = num_samples - i;
+      uint32_t t = (uint32_t) ( (uint64_t) i * 1000 / rate_hz );
+
+      i += onset_detector_process( &det, &samples[i],
+                                   (uint16_t) ( left > ONSET_MAX_BATCH
+                                                   ? ONSET_MAX_BATCH
+                                                   : left ),
+                                   t );
+   }
+
+   printf( "\n%lu samples at %d Hz, %lu onsets, avg tempo %u bpm\n",
+           (unsigned long) num_samples, rate_hz,
+           (unsigned long) num_onsets, est.avg_tempo );
+
+   if( first_tap_ms > 0 && num_onsets > 0
+       && first_onset + 100 < (uint32_t) first_tap_ms ) {
+      printf( "FAIL: onset at %lu ms, before the first tap\n",
+              (unsigned long) first_onset );
+      failed = 1;
+   }
+   if( expect_bpm > 0
+       && abs( (int) est.avg_tempo - expect_bpm ) > EXPECT_TOLERANCE_BPM ) {
+      printf( "FAIL: expected %d bpm\n", expect_bpm );
+      failed = 1;
+   }
+   return failed;
+}
@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////
+//
+// pendulum_sim.c
+//
+// Runs src/pendulum_path.c the way the metronome window does - a frame
+// timer re-armed every frame_ms, the beat telling it each grid point -
+// and reports what each frame would redraw.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o pendulum_sim tools/pendulum_sim.c src/pendulum_path.c
+//    ./pendulum_sim [tempo] [frame_ms] [frame_cost_ms] [seconds]
+//
+// For each style, one beat is listed frame by frame: when, the dirty
+// box and its pixels, or that the frame was skipped for the beat.
+// Then over the whole run: frames per beat drawn and skipped, and
+// dirty pixels per frame against redrawing the whole area.
+//
+// frame_cost_ms stands in for what the update proc takes on the watch
+// (the Diagnostics window's "max ... ms"); it's what decides which
+// frames are too close to a beat to draw.
+//
+
+#include "pendulum_path.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// The area metronome.c gives the pendulum: above the tempo, clear of
+// the "up" label.
+#define AREA_W ( 144 - 34 )
+#define AREA_H (46)
+
+static const char* const style_names[] = { "swing", "sweep" };
+
+static void run( pendulum_style style,
+                 int tempo,
+                 int frame_ms,
+                 int frame_cost_ms,
+                 int seconds )
+{
+   pendulum_path path = { 0 };
+   pendulum_stats stats = { 0 };
+   uint32_t interval = 60000 / tempo;
+   uint32_t end = (uint32_t) seconds * 1000;
+   uint32_t next_beat = 0;
+   uint32_t next_frame = frame_ms;
+   uint32_t beats = 0;
+   uint64_t pixel_sum = 0;
+
+   path.style = style;
+   path.area.w = AREA_W;
+   path.area.h = AREA_H;
+   pendulum_path_place( &path, 0 );
+   path.old_box = pendulum_path_box( &path );
+
+   printf( "%s, %d bpm, a frame every %d ms costing %d ms\n",
+           style_names[style], tempo, frame_ms, frame_cost_ms );
+   printf( "  beat 2:\n" );
+
+   while( next_beat < end || next_frame < end ) {
+      // The beat first, should they coincide: it's armed for the grid
+      // point, the frame timer from the last frame.
+      if( next_beat <= next_frame ) {
+         pendulum_path_beat( &path, next_beat, interval );
+         beats++;
+         next_beat += interval;
+      } else {
+         uint32_t now = next_frame;
+         bool listed = ( beats == 2 );
+         pendulum_box dirty;
+
+         next_frame += frame_ms;
+         if( ! pendulum_path_frame( &path, now, &stats, &dirty ) ) {
+            if( listed ) {
+               printf( "  %6lu ms  skipped, %lu ms before the beat\n",
+                       (unsigned long) now,
+                       (unsigned long) ( next_beat - now ) );
+            }
+            continue;
+         }
+         stats.last_frame_ms = frame_cost_ms;
+         pixel_sum += stats.last_pixels;
+         if( listed ) {
+            printf( "  %6lu ms  %3d x %2d at %3d,%2d  %5u px\n",
+                    (unsigned long) now, dirty.w, dirty.h,
+                    dirty.x, dirty.y, stats.last_pixels );
+         }
+      }
+   }
+
+   printf( "  %lu beats: %.1f frames drawn and %.1f skipped per beat\n",
+           (unsigned long) beats,
+           (double) stats.frames_drawn / beats,
+           (double) stats.frames_skipped / beats );
+   printf( "  dirty px per frame: mean %.0f, max %u, of %d for the"
+           " whole area\n\n",
+           stats.frames_drawn ? (double) pixel_sum / stats.frames_drawn
+                              : 0.0,
+           stats.max_pixels, AREA_W * AREA_H );
+}
+
+int main( int argc, char** argv )
+{
+   int tempo = ( argc > 1 ) ? atoi( argv[1] ) : 120;
+   int frame_ms = ( argc > 2 ) ? atoi( argv[2] ) : 50;
+   int frame_cost_ms = ( argc > 3 ) ? atoi( argv[3] ) : 4;
+   int seconds = ( argc > 4 ) ? atoi( argv[4] ) : 10;
+
+   if(    tempo <= 0 || tempo > 255 || frame_ms <= 0
+       || frame_cost_ms < 0 || seconds <= 0 ) {
+      fprintf( stderr,
+               "usage: %s [tempo] [frame_ms] [frame_cost_ms] [seconds]\n",
+               argv[0] );
+      return 2;
+   }
+
+   run( PENDULUM_SWING, tempo, frame_ms, frame_cost_ms, seconds );
+   run( PENDULUM_SWEEP, tempo, frame_ms, frame_cost_ms, seconds );
+   return 0;
+}
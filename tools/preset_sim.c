@@ -0,0 +1,460 @@
+////////////////////////////////////////////////////////////////////////
+//
+// preset_sim.c
+//
+// Host stand-in for the phone side of src/preset_proto.c.  A phone
+// pushes NUM_PUSHES edits of a library of presets and settings to one
+// watch over a simulated link that loses and reorders messages, and
+// drops out altogether for a while during the first push so it has to
+// resume.  It reports the throughput and how late the transfers made
+// the beat.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o preset_sim tools/preset_sim.c src/preset_proto.c
+//    ./preset_sim [loss_pct] [delay_ms] [jitter_ms] [msg_cost_us]
+//
+// Each message takes delay_ms plus a uniformly random 0..jitter_ms,
+// so with a window of more than one chunk in flight they arrive out
+// of order.  loss_pct of messages each way are lost.  From
+// DROPOUT_AT_MS the link is down for DROPOUT_MS; the phone then says
+// HELLO again in the same session and carries on from the seq the
+// watch reports.  Each push is a new session, and only sends the
+// slots the watch's checksums say have changed.
+//
+// The watch runs one event loop.  Handling a message keeps it busy
+// for msg_cost_us plus BYTE_COST_US per byte (a model - the AppMessage
+// dictionary parse and the copies - not a measurement), and a beat
+// timer that comes due meanwhile waits.  The watch is busy well under
+// 1% of the time, so left to chance a message would hardly ever be
+// in the way; instead any message to the watch that would land within
+// COLLIDE_MS after a beat lands one tick before it, and holds it up.
+// Beat lateness is reported while the transfer runs and after it,
+// against the most one message can cost; the beat at TEMPO_BPM never
+// sees anything else.
+//
+// Exits non-zero if, after any push, the watch doesn't have the
+// phone's presets and settings, or if a beat is ever later than that
+// bound.
+//
+
+#include "preset_proto.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_IN_FLIGHT (64)
+#define MAX_MESSAGE (128)
+#define MAX_CHUNKS (64)
+#define MAX_BEATS (1024)
+
+// Four presets fill the watch's inbox (see PHONE_LINK_INBOUND_SIZE).
+#define ENTRIES_PER_CHUNK (4)
+#define WINDOW (2)
+#define RESEND_MS (400)
+// Resends without progress before the phone decides the watch has
+// lost the thread and says HELLO again.
+#define MAX_RESENDS (3)
+
+#define NUM_PUSHES (8)
+#define PUSH_GAP_MS (500)
+
+#define DROPOUT_AT_MS (100)
+#define DROPOUT_MS (2000)
+
+#define TEMPO_BPM (200)
+#define BYTE_COST_US (4)
+#define SIM_MS (20000)
+#define TICK_US (100)
+#define COLLIDE_MS (60)
+
+typedef struct {
+   uint32_t deliver_us;
+   int to_phone;
+   uint8_t data[MAX_MESSAGE];
+   uint16_t len;
+} message;
+
+static message in_flight[MAX_IN_FLIGHT];
+static int num_in_flight;
+static int loss_pct = 5;
+static int delay_ms = 30;
+static int jitter_ms = 40;
+static int msg_cost_us = 400;
+static uint32_t sent[2];
+static uint32_t lost[2];
+static uint32_t beat_us = 60000000U / TEMPO_BPM;
+static uint32_t collided;
+
+// The watch.
+static preset_store store;
+static preset_settings watch_settings;
+static uint32_t busy_until_us;
+
+// The phone: what it wants on the watch, and the transfer of it.
+static preset phone_slots[PRESET_MAX_SLOTS];
+static preset_settings phone_settings = { 120, 16, 1, 0 };
+static uint16_t session = 0x5A17;
+static uint8_t chunks[MAX_CHUNKS][MAX_MESSAGE];
+static uint16_t chunk_len[MAX_CHUNKS];
+static int num_chunks;
+static uint16_t base_seq;
+static int have_status;
+static int acked;           // chunks acked, from base_seq
+static int next_chunk;      // next to send
+static uint32_t last_progress_us;
+static int resends;
+static int pushing;
+static int finished;        // a push has just finished
+static uint32_t bytes_sent;
+static uint32_t push_us;    // time spent in pushes, all told
+
+static int32_t beat_late_us[2][MAX_BEATS];
+static int num_beats[2];
+
+static uint16_t get_u16( const uint8_t* p )
+{
+   return p[0] | ( p[1] << 8 );
+}
+
+static void put_u16( uint8_t* p, uint16_t v )
+{
+   p[0] = v & 0xFF;
+   p[1] = v >> 8;
+}
+
+static int link_up( uint32_t now_us )
+{
+   return    now_us < DROPOUT_AT_MS * 1000U
+          || now_us >= ( DROPOUT_AT_MS + DROPOUT_MS ) * 1000U;
+}
+
+static void send( int to_phone, const uint8_t* data, uint16_t len,
+                  uint32_t now_us )
+{
+   message* m;
+
+   if( len == 0 ) {
+      return;
+   }
+   sent[to_phone]++;
+   if(    ! link_up( now_us )
+       || rand() % 100 < loss_pct
+       || num_in_flight == MAX_IN_FLIGHT ) {
+      lost[to_phone]++;
+      return;
+   }
+   m = &in_flight[num_in_flight++];
+   m->deliver_us = now_us
+      + ( delay_ms + ( jitter_ms ? rand() % ( jitter_ms + 1 ) : 0 ) ) * 1000;
+   if( ! to_phone ) {
+      // Just after a beat: move it to just before, where it's in the
+      // beat's way.  Never before it was sent.
+      uint32_t since_beat = m->deliver_us % beat_us;
+
+      if(    since_beat < COLLIDE_MS * 1000U
+          && m->deliver_us - since_beat - TICK_US > now_us ) {
+         m->deliver_us -= since_beat + TICK_US;
+         collided++;
+      }
+   }
+   m->to_phone = to_phone;
+   m->len = len;
+   memcpy( m->data, data, len );
+}
+
+static void apply_settings( const preset_settings* settings )
+{
+   watch_settings = *settings;
+}
+
+// Preset i as of push k.  Each push edits about a third of them.
+static void make_preset( preset* p, int i, int k )
+{
+   memset( p, 0, sizeof(*p) );
+   snprintf( p->name, PRESET_NAME_SIZE, "Song %u", (uint8_t) ( i + 1 ) );
+   p->tempo = (uint8_t) ( 60 + i * 9 + ( i % 3 == k % 3 ? k : 0 ) );
+   p->beats_per_bar = (uint8_t) ( 3 + i % 3 );
+   p->beat_unit = 4;
+   p->subdivisions = (uint8_t) ( 1 + i % 4 );
+   p->swing_pct = (uint8_t) ( 50 + i % 3 * 8 );
+   p->shift_ms = (int8_t) ( i % 5 - 2 );
+}
+
+static void send_hello( uint32_t now_us )
+{
+   uint8_t msg[PRESET_HEADER_SIZE];
+
+   msg[0] = PRESET_MSG_HELLO;
+   put_u16( &msg[1], session );
+   put_u16( &msg[3], 0 );
+   send( 0, msg, sizeof(msg), now_us );
+}
+
+// Chunk up whatever differs from the watch's checksums.
+static void build_chunks( const uint8_t* status )
+{
+   uint8_t* c = NULL;
+   uint16_t len = 0;
+
+   num_chunks = 0;
+   for( int s = 0; s <= PRESET_MAX_SLOTS; s++ ) {
+      if( c == NULL || c[PRESET_HEADER_SIZE] == ENTRIES_PER_CHUNK ) {
+         if( c != NULL ) {
+            chunk_len[num_chunks++] = len;
+         }
+         c = chunks[num_chunks];
+         len = PRESET_HEADER_SIZE + 1;
+         c[PRESET_HEADER_SIZE] = 0;
+      }
+      if( s == PRESET_MAX_SLOTS ) {
+         // Settings always go.
+         c[len++] = PRESET_ENTRY_SETTINGS;
+         memcpy( &c[len], &phone_settings, sizeof(phone_settings) );
+         len += sizeof(phone_settings);
+      } else if(    get_u16( &status[PRESET_HEADER_SIZE + 1 + 2 * s] )
+                 == preset_checksum( &phone_slots[s] ) ) {
+         continue;
+      } else if( phone_slots[s].name[0] == '\0' ) {
+         c[len++] = PRESET_ENTRY_DELETE;
+         c[len++] = (uint8_t) s;
+      } else {
+         c[len++] = PRESET_ENTRY_PRESET;
+         c[len++] = (uint8_t) s;
+         memcpy( &c[len], &phone_slots[s], sizeof(preset) );
+         len += sizeof(preset);
+      }
+      c[PRESET_HEADER_SIZE]++;
+   }
+   chunk_len[num_chunks++] = len;
+}
+
+static void send_chunks( uint32_t now_us )
+{
+   while( next_chunk < num_chunks && next_chunk < acked + WINDOW ) {
+      uint8_t* c = chunks[next_chunk];
+
+      c[0] = PRESET_MSG_CHUNK;
+      put_u16( &c[1], session );
+      put_u16( &c[3], (uint16_t) ( base_seq + next_chunk ) );
+      send( 0, c, chunk_len[next_chunk], now_us );
+      bytes_sent += chunk_len[next_chunk];
+      next_chunk++;
+   }
+}
+
+static void phone_receive( const message* m, uint32_t now_us )
+{
+   uint16_t seq = get_u16( &m->data[3] );
+
+   if( m->data[0] == PRESET_MSG_STATUS ) {
+      if( ! have_status ) {
+         build_chunks( m->data );
+         base_seq = seq;
+         have_status = 1;
+      }
+      // Resume from wherever the watch got to.
+      acked = (int16_t) ( seq - base_seq );
+      next_chunk = acked;
+      last_progress_us = now_us;
+      resends = 0;
+      send_chunks( now_us );
+   } else if( m->data[0] == PRESET_MSG_ACK && have_status ) {
+      int a = (int16_t) ( seq - base_seq ) + 1;
+
+      if( a > acked ) {
+         acked = a;
+         last_progress_us = now_us;
+         resends = 0;
+         if( acked == num_chunks && pushing ) {
+            pushing = 0;
+            finished = 1;
+         }
+         send_chunks( now_us );
+      }
+   }
+}
+
+static void phone_poll( uint32_t now_us )
+{
+   if( ! pushing || now_us - last_progress_us < RESEND_MS * 1000U ) {
+      return;
+   }
+   last_progress_us = now_us;
+   if( ! have_status || ++resends > MAX_RESENDS ) {
+      // Nothing heard for a while: ask the watch where it's got to.
+      resends = 0;
+      send_hello( now_us );
+   } else {
+      // Go back to the first chunk not acked.
+      next_chunk = acked;
+      send_chunks( now_us );
+   }
+}
+
+static int cmp_i32( const void* a, const void* b )
+{
+   int32_t x = *(const int32_t*) a;
+   int32_t y = *(const int32_t*) b;
+   return ( x > y ) - ( x < y );
+}
+
+static void report_beats( const char* what, int32_t* late, int n )
+{
+   int64_t sum = 0;
+
+   if( n == 0 ) {
+      printf( "%-16s no beats\n", what );
+      return;
+   }
+   qsort( late, n, sizeof(late[0]), &cmp_i32 );
+   for( int i = 0; i < n; i++ ) {
+      sum += late[i];
+   }
+   printf( "%-16s %4d beats  late us: mean %5lld  p99 %5ld  max %5ld\n",
+           what, n, (long long) ( sum / n ),
+           (long) late[( n - 1 ) * 99 / 100],
+           (long) late[n - 1] );
+}
+
+static void start_push( int k, uint32_t now_us )
+{
+   for( int i = 0; i < 14; i++ ) {
+      make_preset( &phone_slots[i], i, k );
+   }
+   phone_settings.stop_after = (uint8_t) k;
+   session++;
+   have_status = 0;
+   pushing = 1;
+   last_progress_us = now_us;
+   resends = 0;
+   send_hello( now_us );
+}
+
+static int check_watch( int k )
+{
+   if(    memcmp( store.slots, phone_slots, sizeof(phone_slots) ) != 0
+       || memcmp( &watch_settings, &phone_settings,
+                  sizeof(phone_settings) ) != 0 ) {
+      printf( "FAIL: after push %d the watch doesn't match the phone\n",
+              k + 1 );
+      return 0;
+   }
+   return 1;
+}
+
+int main( int argc, char** argv )
+{
+   uint32_t next_beat_us = beat_us;
+   int32_t bound_us;
+   uint32_t push_start_us = 0;
+   uint32_t next_push_us = 0;
+   int pushes = 0;
+   int ok = 1;
+
+   if( argc > 1 ) loss_pct = atoi( argv[1] );
+   if( argc > 2 ) delay_ms = atoi( argv[2] );
+   if( argc > 3 ) jitter_ms = atoi( argv[3] );
+   if( argc > 4 ) msg_cost_us = atoi( argv[4] );
+
+   srand( 1 );
+   preset_store_init( &store, &apply_settings );
+
+   // Before the first push the watch already has some of them, one
+   // of them out of date, and one the phone doesn't have.
+   for( int i = 0; i < 5; i++ ) {
+      make_preset( &store.slots[i], i, 0 );
+   }
+   store.slots[2].tempo++;
+   make_preset( &store.slots[15], 15, 0 );
+
+   printf( "%d pushes, loss %d%%, %d+0..%d ms, window %d, "
+           "dropout %d ms at %d ms\n",
+           NUM_PUSHES, loss_pct, delay_ms, jitter_ms, WINDOW, DROPOUT_MS,
+           DROPOUT_AT_MS );
+
+   for( uint32_t now_us = 0; now_us < SIM_MS * 1000U; now_us += TICK_US ) {
+      if( ! pushing && pushes < NUM_PUSHES && now_us >= next_push_us ) {
+         start_push( pushes, now_us );
+         push_start_us = now_us;
+      }
+
+      // The beat runs as soon as the watch is free.
+      if( now_us >= next_beat_us && now_us >= busy_until_us ) {
+         if( num_beats[pushing] < MAX_BEATS ) {
+            beat_late_us[pushing][num_beats[pushing]++] =
+               (int32_t) ( now_us - next_beat_us );
+         }
+         next_beat_us += beat_us;
+      }
+
+      for( int i = 0; i < num_in_flight; ) {
+         message m = in_flight[i];
+
+         if( m.deliver_us > now_us || ( ! m.to_phone
+                                        && now_us < busy_until_us ) ) {
+            i++;
+            continue;
+         }
+         in_flight[i] = in_flight[--num_in_flight];
+         if( m.to_phone ) {
+            phone_receive( &m, now_us );
+            if( finished ) {
+               finished = 0;
+               push_us += now_us - push_start_us;
+               ok &= check_watch( pushes );
+               pushes++;
+               next_push_us = now_us + PUSH_GAP_MS * 1000;
+            }
+         } else {
+            uint8_t reply[PRESET_MAX_MESSAGE];
+            uint16_t len = preset_proto_handle( &store, m.data, m.len,
+                                                reply );
+
+            busy_until_us = now_us + msg_cost_us + BYTE_COST_US * m.len;
+            send( 1, reply, len, busy_until_us );
+         }
+      }
+
+      phone_poll( now_us );
+   }
+
+   printf( "sent %lu msgs (%lu lost), watch sent %lu (%lu lost)\n",
+           (unsigned long) sent[0], (unsigned long) lost[0],
+           (unsigned long) sent[1], (unsigned long) lost[1] );
+   printf( "watch: %lu chunks applied, %lu duplicate, %lu out of order, "
+           "%lu bad\n",
+           (unsigned long) store.stats.chunks,
+           (unsigned long) store.stats.duplicates,
+           (unsigned long) store.stats.gaps,
+           (unsigned long) store.stats.bad );
+   if( pushes == NUM_PUSHES ) {
+      printf( "%d pushes in %lu ms, %lu B applied, %lu B/s sent, "
+              "%lu B/s useful\n",
+              pushes, (unsigned long) ( push_us / 1000 ),
+              (unsigned long) store.stats.bytes,
+              (unsigned long) ( (uint64_t) bytes_sent * 1000000 / push_us ),
+              (unsigned long) ( (uint64_t) store.stats.bytes * 1000000
+                                / push_us ) );
+   } else {
+      printf( "FAIL: only %d of %d pushes finished\n", pushes, NUM_PUSHES );
+      ok = 0;
+   }
+   // Work per message is bounded by one chunk, so this is the most a
+   // transfer can ever hold a beat up.
+   bound_us = msg_cost_us + BYTE_COST_US * MAX_MESSAGE;
+   printf( "%lu msgs landed just before a beat; one costs at most %ld us\n",
+           (unsigned long) collided, (long) bound_us );
+   report_beats( "beat, pushing:", beat_late_us[1], num_beats[1] );
+   report_beats( "beat, idle:", beat_late_us[0], num_beats[0] );
+   for( int p = 0; p < 2; p++ ) {
+      if( num_beats[p] > 0 && beat_late_us[p][num_beats[p] - 1] > bound_us ) {
+         printf( "FAIL: a beat was %ld us late\n",
+                 (long) beat_late_us[p][num_beats[p] - 1] );
+         ok = 0;
+      }
+   }
+
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+////////////////////////////////////////////////////////////////////////
+//
+// sync_sim.c
+//
+// Simulated ensemble link for src/clock_sync.c.  Runs a phone and a
+// number of watches on the host, each watch with its own clock offset
+// and skew, over a link with configurable delay and jitter, and
+// reports how far apart the watches would sound a beat of the shared
+// grid.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o sync_sim tools/sync_sim.c src/clock_sync.c
+//    ./sync_sim [watches] [delay_ms] [jitter_ms] [minutes]
+//
+// Each message takes delay_ms plus a uniformly random 0..jitter_ms
+// each way.  Watches poll when the ensemble is turned on and then
+// every CLOCK_SYNC_TIMEOUT_MS, as the app's sync timer does whether
+// the beat is running or not.
+//
+// First, each of the first messages of an acquisition is lost in
+// turn, with the beat stopped, and the watch must still be synced
+// within LOST_SYNC_S.  The exit status is non-zero if it isn't.
+//
+
+#include "clock_sync.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MAX_WATCHES (16)
+#define MAX_IN_FLIGHT (64)
+#define BEAT_MS (500)
+#define POLL_MS (CLOCK_SYNC_TIMEOUT_MS)
+#define PHONE_PROCESSING_MS (3)
+#define LOST_SYNC_S (30)
+
+typedef struct {
+   int64_t offset_us;   // local clock at true time 0
+   int32_t skew_ppm;
+   clock_sync cs;
+} watch;
+
+typedef struct {
+   int64_t deliver_us;  // true time
+   int to_phone;
+   int watch;
+   uint8_t data[CLOCK_SYNC_MAX_MESSAGE];
+   uint16_t len;
+} message;
+
+static watch watches[MAX_WATCHES];
+static message in_flight[MAX_IN_FLIGHT];
+static int num_in_flight;
+static int num_watches = 4;
+static int delay_ms = 40;
+static int jitter_ms = 60;
+static uint32_t messages_sent;
+// Lose the message sent as this one (counting from 1), or none if 0.
+static uint32_t lose_message;
+
+static uint32_t local_ms( const watch* w, int64_t true_us )
+{
+   int64_t local_us = w->offset_us + true_us
+      + true_us * w->skew_ppm / 1000000;
+   return (uint32_t) ( local_us / 1000 );
+}
+
+static int64_t true_us_of_local( const watch* w, uint32_t local, int64_t near_us )
+{
+   // local_ms() is monotonic, so step toward it from a nearby guess.
+   int64_t t = near_us;
+   for( int i = 0; i < 4; i++ ) {
+      int32_t err = (int32_t) ( local - local_ms( w, t ) );
+      t += (int64_t) err * 1000;
+   }
+   return t;
+}
+
+static void send( int to_phone, int w, const uint8_t* data, uint16_t len,
+                  int64_t now_us )
+{
+   message* m;
+
+   if( len == 0 || num_in_flight == MAX_IN_FLIGHT ) {
+      return;
+   }
+   if( ++messages_sent == lose_message ) {
+      return;
+   }
+   m = &in_flight[num_in_flight++];
+   m->deliver_us = now_us
+      + ( delay_ms + ( jitter_ms ? rand() % ( jitter_ms + 1 ) : 0 ) ) * 1000;
+   m->to_phone = to_phone;
+   m->watch = w;
+   m->len = len;
+   for( int i = 0; i < len; i++ ) {
+      m->data[i] = data[i];
+   }
+}
+
+static void put_u32( uint8_t* p, uint32_t v )
+{
+   p[0] = v & 0xFF;
+   p[1] = ( v >> 8 ) & 0xFF;
+   p[2] = ( v >> 16 ) & 0xFF;
+   p[3] = v >> 24;
+}
+
+static void deliver( const message* m, int64_t now_us )
+{
+   watch* w = &watches[m->watch];
+   uint8_t out[CLOCK_SYNC_MAX_MESSAGE];
+
+   if( m->to_phone ) {
+      // The phone's clock is true time.
+      uint32_t t2 = (uint32_t) ( now_us / 1000 );
+      out[0] = CLOCK_SYNC_MSG_RESPONSE;
+      out[1] = m->data[1];
+      out[2] = m->data[2];
+      out[3] = m->data[3];
+      out[4] = m->data[4];
+      out[5] = m->data[5];
+      put_u32( &out[6], t2 );
+      put_u32( &out[10], t2 + PHONE_PROCESSING_MS );
+      send( 0, m->watch, out, 14, now_us + PHONE_PROCESSING_MS * 1000 );
+   } else {
+      uint8_t len = clock_sync_handle_response( &w->cs, m->data, m->len,
+                                                local_ms( w, now_us ), out );
+      send( 1, m->watch, out, len, now_us );
+   }
+}
+
+// Spread, in true us, of where the watches would sound shared time s.
+static int64_t spread_us( uint32_t s, int64_t near_us )
+{
+   int64_t lo = 0;
+   int64_t hi = 0;
+
+   for( int i = 0; i < num_watches; i++ ) {
+      watch* w = &watches[i];
+      uint32_t local = clock_sync_to_local( &w->cs, s );
+      int64_t t = true_us_of_local( w, local, near_us );
+      if( i == 0 || t < lo ) {
+         lo = t;
+      }
+      if( i == 0 || t > hi ) {
+         hi = t;
+      }
+   }
+   return hi - lo;
+}
+
+// Deliver what's due, and poll if the sync timer is.
+static void step( int64_t now_us )
+{
+   for( int i = 0; i < num_in_flight; ) {
+      if( in_flight[i].deliver_us <= now_us ) {
+         message m = in_flight[i];
+         in_flight[i] = in_flight[--num_in_flight];
+         deliver( &m, now_us );
+      } else {
+         i++;
+      }
+   }
+
+   if( now_us % ( POLL_MS * 1000 ) == 0 ) {
+      for( int i = 0; i < num_watches; i++ ) {
+         uint8_t out[CLOCK_SYNC_MAX_MESSAGE];
+         uint8_t len = clock_sync_poll( &watches[i].cs,
+                                        local_ms( &watches[i], now_us ),
+                                        out );
+         send( 1, i, out, len, now_us );
+      }
+   }
+}
+
+static void reset( void )
+{
+   srand( 1 );
+   num_in_flight = 0;
+   messages_sent = 0;
+   for( int i = 0; i < num_watches; i++ ) {
+      watches[i].offset_us = (int64_t) ( rand() % 100000000 ) * 1000;
+      watches[i].skew_ppm = rand() % 201 - 100;
+      clock_sync_init( &watches[i].cs );
+   }
+}
+
+// One watch, beat stopped: lose each message of the acquisition in
+// turn, and see it synced all the same.
+static int check_lost_message( void )
+{
+   int watches_wanted = num_watches;
+   int64_t worst_us = 0;
+   int ok = 1;
+
+   num_watches = 1;
+   for( lose_message = 1;
+        lose_message <= 2 * CLOCK_SYNC_ACQUIRE;
+        lose_message++ ) {
+      int64_t now_us;
+
+      reset();
+      for( now_us = 0; now_us <= LOST_SYNC_S * 1000000LL; now_us += 1000 ) {
+         step( now_us );
+         if( clock_sync_is_synced( &watches[0].cs ) ) {
+            break;
+         }
+      }
+      if( ! clock_sync_is_synced( &watches[0].cs ) ) {
+         printf( "FAIL: message %u lost, not synced in %d s\n",
+                 lose_message, LOST_SYNC_S );
+         ok = 0;
+      } else if( now_us > worst_us ) {
+         worst_us = now_us;
+      }
+   }
+   if( ok ) {
+      printf( "any one of the first %d messages lost: synced within"
+              " %.1f s\n",
+              2 * CLOCK_SYNC_ACQUIRE, worst_us / 1000000.0 );
+   }
+   lose_message = 0;
+   num_watches = watches_wanted;
+   return ok;
+}
+
+int main( int argc, char** argv )
+{
+   int minutes = 10;
+   int64_t end_us;
+   int64_t lo_us = 0;
+   int64_t hi_us = 0;
+   int64_t sum_us = 0;
+   int64_t worst_us = 0;
+   int ok;
+
+   if( argc > 1 ) num_watches = atoi( argv[1] );
+   if( argc > 2 ) delay_ms = atoi( argv[2] );
+   if( argc > 3 ) jitter_ms = atoi( argv[3] );
+   if( argc > 4 ) minutes = atoi( argv[4] );
+   if( num_watches < 1 || num_watches > MAX_WATCHES ) {
+      fprintf( stderr, "watches must be 1..%d\n", MAX_WATCHES );
+      return 1;
+   }
+
+   printf( "%d watches, %d+0..%d ms each way, %d min\n",
+           num_watches, delay_ms, jitter_ms, minutes );
+   ok = check_lost_message();
+
+   reset();
+   printf( "minute  synced  spread_ms  worst_ms  messages\n" );
+
+   end_us = (int64_t) minutes * 60 * 1000000;
+   for( int64_t now_us = 0; now_us <= end_us; now_us += 1000 ) {
+      int64_t worst = 0;
+      int synced = 0;
+
+      step( now_us );
+
+      if( now_us > 0 && now_us % ( 60 * 1000000LL ) == 0 ) {
+         for( int i = 0; i < num_watches; i++ ) {
+            synced += clock_sync_is_synced( &watches[i].cs );
+         }
+         // Sample the spread over the next minute's beats.
+         for( int b = 0; b < 120; b++ ) {
+            int64_t t = now_us + (int64_t) b * BEAT_MS * 1000;
+            int64_t sp = spread_us( (uint32_t) ( t / 1000 ), t );
+            if( sp > worst ) {
+               worst = sp;
+            }
+         }
+         int64_t sp = spread_us( (uint32_t) ( now_us / 1000 ), now_us );
+         printf( "%6d  %6d  %9.1f  %8.1f  %8u\n",
+                 (int) ( now_us / 60000000 ), synced,
+                 sp / 1000.0, worst / 1000.0, messages_sent );
+         if( now_us == 60 * 1000000LL || sp < lo_us ) {
+            lo_us = sp;
+         }
+         if( sp > hi_us ) {
+            hi_us = sp;
+         }
+         if( worst > worst_us ) {
+            worst_us = worst;
+         }
+         sum_us += sp;
+      }
+   }
+
+   if( minutes > 0 ) {
+      printf( "spread_ms min %.1f  mean %.1f  max %.1f; worst beat %.1f\n",
+              lo_us / 1000.0, sum_us / 1000.0 / minutes, hi_us / 1000.0,
+              worst_us / 1000.0 );
+   }
+   return ok ? 0 : 1;
+}
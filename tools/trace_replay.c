@@ -0,0 +1,417 @@
+////////////////////////////////////////////////////////////////////////
+//
+// trace_replay.c
+//
+// Replays a timer trace recorded on the watch (Record Trace in the
+// menu; see src/timer_trace.h) under each beat_sched policy, and
+// reports how each would have kept time.
+//
+// The trace holds how late the OS fired each beat and frame timer.
+// Every policy gets the same lateness, in the order it happened: the
+// n-th beat timer a policy arms fires as late as the n-th one on the
+// watch did.  The beat runs wherever it ran on the watch, between the
+// trace's start and stop marks, at the trace's tempo, straight.
+//
+// Build and run from the top of the tree:
+//
+//    cc -std=c99 -Isrc -o trace_replay tools/trace_replay.c
+//       src/beat_sched.c src/latency_hist.c -lm    (one line)
+//    ./trace_replay trace.bin [recovery] [stall_every_s stall_ms]
+//
+// trace.bin is the image as the phone read it.  Reported per policy:
+// beats played; mean and p99 of |error|, each beat's output against
+// its grid point; drift, the worst error at the end of a run; jitter,
+// the standard deviation of beat-to-beat intervals; OS timer wakeups
+// per second, beat and frame timers together; and beats missed and
+// dropped (see beat_sched.h).
+//
+// recovery is how missed beats are recovered from: skip (the watch's
+// default), catch-up or shift.  To see recovery at work, inject
+// stalls: every stall_every_s seconds of each run, the OS fires
+// nothing for stall_ms, and timers due meanwhile all fire at its end.
+//
+
+#include "beat_sched.h"
+#include "latency_hist.h"
+#include "timer_trace.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The pendulum's frame interval.
+#define FRAME_MS (50)
+
+#define MAX_RUNS (64)
+#define BUTTON_SELECT (2)
+
+typedef struct {
+   uint32_t start;
+   uint32_t stop;
+   // Select went down this long before the start, or -1.
+   int32_t press_ms;
+} run;
+
+typedef struct {
+   const int16_t* late;
+   int n;
+   int next;
+} late_stream;
+
+typedef struct {
+   uint32_t beats;
+   uint32_t wakeups;
+   uint32_t ms;
+   double error_sum;
+   latency_hist error;
+   int32_t drift;
+   double interval_sum;
+   double interval_sq;
+   uint32_t intervals;
+   uint32_t misses;
+   uint32_t dropped;
+} result;
+
+static uint8_t image[TIMER_TRACE_HEADER_SIZE
+                     + TIMER_TRACE_MAX_RECORDS * TIMER_TRACE_RECORD_SIZE];
+
+static int16_t beat_late[TIMER_TRACE_MAX_RECORDS];
+static int16_t frame_late[TIMER_TRACE_MAX_RECORDS];
+static run runs[MAX_RUNS];
+static int num_runs;
+
+static beat_sched_recovery recovery = BEAT_SCHED_SKIP;
+static uint32_t stall_every_ms;
+static uint32_t stall_ms;
+
+// When a timer due to fire at fire, in a run from start, really fires.
+static uint32_t stalled( uint32_t fire, uint32_t start )
+{
+   uint32_t into;
+
+   if( stall_every_ms == 0 || fire - start < stall_every_ms ) {
+      return fire;
+   }
+   into = ( fire - start ) % stall_every_ms;
+   return ( into < stall_ms ) ? fire - into + stall_ms : fire;
+}
+
+static int next_late( late_stream* s )
+{
+   if( s->n == 0 ) {
+      return 0;
+   }
+   return s->late[s->next++ % s->n];
+}
+
+static void add_interval( result* r, double interval, double nominal )
+{
+   double d = interval - nominal;
+
+   r->interval_sum += d;
+   r->interval_sq += d * d;
+   r->intervals++;
+}
+
+static void replay_run( const run* rn,
+                        beat_sched_policy policy,
+                        uint8_t tempo,
+                        uint8_t slots,
+                        bool frames,
+                        late_stream* beats,
+                        late_stream* frame_stream,
+                        result* r )
+{
+   uint32_t slot_q8 = ( 60000UL * 256 / tempo ) / slots;
+   double nominal = slot_q8 / 256.0;
+   beat_sched sched;
+   uint32_t slot = 0;
+   uint32_t now = rn->start;
+   uint32_t last_out = rn->start;
+   uint32_t last_slot = 0;
+   uint32_t shifted = 0;
+   int32_t err = 0;
+
+   beat_sched_init( &sched,
+                    policy,
+                    ( policy == BEAT_SCHED_MULTIPLEX && frames )
+                       ? FRAME_MS : 0 );
+   beat_sched_set_recovery( &sched, recovery );
+   beat_sched_set_slot_ms( &sched, slot_q8 >> 8 );
+   beat_sched_start( &sched, now );
+   r->ms += rn->stop - rn->start;
+
+   // Starting plays the first beat there and then.
+   r->beats++;
+   latency_hist_add( &r->error, 0 );
+
+   for( ;; ) {
+      uint32_t ideal = rn->start + ( ( ++slot * slot_q8 ) >> 8 );
+      uint32_t deadline = ideal + shifted;
+      beat_sched_action action;
+      int32_t shift_ms;
+      bool dropped = false;
+
+      do {
+         uint32_t delay = beat_sched_delay( &sched, deadline, now );
+         bool is_frame = ( policy == BEAT_SCHED_MULTIPLEX
+                           && sched.frame_ms > 0
+                           && (int32_t) ( sched.frame_time
+                                          - deadline ) < 0 );
+         int32_t late = next_late( is_frame ? frame_stream : beats );
+         uint32_t fire = now + delay;
+
+         // The OS may fire early, but not before it was asked.
+         fire = ( late < 0 && (uint32_t) -late > delay ) ? now
+                                                         : fire + late;
+         fire = stalled( fire, rn->start );
+         if( (int32_t) ( fire - rn->stop ) >= 0 ) {
+            goto done;
+         }
+         r->wakeups++;
+         now = fire;
+         action = beat_sched_fired( &sched, deadline, now );
+      } while( action != BEAT_SCHED_BEAT );
+
+      // As beat() does: drop, or shift, then play - unless skipping
+      // reached a slot still to come.
+      while(    beat_sched_check( &sched, deadline, now, &shift_ms )
+             == BEAT_SCHED_DROP ) {
+         ideal = rn->start + ( ( ++slot * slot_q8 ) >> 8 );
+         deadline = ideal + shifted;
+         dropped = true;
+      }
+      shifted += shift_ms;
+      if( dropped && (int32_t) ( deadline - now ) > 0 ) {
+         slot--;
+         continue;
+      }
+
+      beat_sched_played( &sched, now );
+      // Against the grid as it was before any shift.
+      err = (int32_t) ( now - ideal );
+      r->beats++;
+      r->error_sum += abs( err );
+      latency_hist_add( &r->error, abs( err ) );
+      // Jitter is between neighbours; a dropped beat's gap isn't one.
+      if( slot == last_slot + 1 ) {
+         add_interval( r, now - last_out, nominal );
+      }
+      last_out = now;
+      last_slot = slot;
+   }
+
+done:
+   if( abs( err ) > abs( r->drift ) ) {
+      r->drift = err;
+   }
+   r->misses += sched.stats.misses;
+   r->dropped += sched.stats.dropped;
+
+   // The pendulum's own timer, re-armed from each frame - unless the
+   // beat is riding on it.
+   if( frames && policy != BEAT_SCHED_MULTIPLEX ) {
+      uint32_t t = rn->start;
+
+      for( ;; ) {
+         int32_t late = next_late( frame_stream );
+
+         t += FRAME_MS + ( ( late < -FRAME_MS ) ? -FRAME_MS : late );
+         if( (int32_t) ( t - rn->stop ) >= 0 ) {
+            break;
+         }
+         r->wakeups++;
+      }
+   }
+}
+
+int main( int argc, char** argv )
+{
+   FILE* f;
+   size_t size;
+   uint8_t num_sources;
+   uint8_t tempo;
+   uint8_t slots;
+   uint16_t count;
+   int beat_src = -1;
+   int frame_src = -1;
+   int num_beat_late = 0;
+   int num_frame_late = 0;
+   uint32_t t = 0;
+   uint32_t last_press = 0;
+   bool pressed = false;
+   bool in_run = false;
+
+   if( argc < 2 ) {
+      fprintf( stderr,
+               "usage: %s trace.bin [skip|catch-up|shift]"
+               " [stall_every_s stall_ms]\n",
+               argv[0] );
+      return 2;
+   }
+   if( argc > 2 ) {
+      if( strcmp( argv[2], "catch-up" ) == 0 ) {
+         recovery = BEAT_SCHED_CATCH_UP;
+      } else if( strcmp( argv[2], "shift" ) == 0 ) {
+         recovery = BEAT_SCHED_SHIFT;
+      } else if( strcmp( argv[2], "skip" ) != 0 ) {
+         fprintf( stderr, "%s: unknown recovery\n", argv[2] );
+         return 2;
+      }
+   }
+   if( argc > 4 ) {
+      stall_every_ms = atoi( argv[3] ) * 1000;
+      stall_ms = atoi( argv[4] );
+      if( stall_ms >= stall_every_ms ) {
+         stall_every_ms = 0;
+      }
+   }
+   f = fopen( argv[1], "rb" );
+   if( f == NULL ) {
+      perror( argv[1] );
+      return 2;
+   }
+   size = fread( image, 1, sizeof(image), f );
+   fclose( f );
+
+   if(    size < TIMER_TRACE_HEADER_SIZE
+       || image[0] != 'T' || image[1] != 'R'
+       || image[2] != TIMER_TRACE_VERSION ) {
+      fprintf( stderr, "%s: not a version %d timer trace\n",
+               argv[1], TIMER_TRACE_VERSION );
+      return 2;
+   }
+   num_sources = image[3];
+   tempo = image[4];
+   slots = image[5] ? image[5] : 1;
+   count = image[6] | ( image[7] << 8 );
+   if( size < TIMER_TRACE_HEADER_SIZE
+              + (size_t) count * TIMER_TRACE_RECORD_SIZE ) {
+      fprintf( stderr, "%s: truncated\n", argv[1] );
+      return 2;
+   }
+   if( tempo == 0 ) {
+      fprintf( stderr, "%s: no tempo\n", argv[1] );
+      return 2;
+   }
+
+   for( int s = 0; s < num_sources && s < TIMER_TRACE_MAX_SOURCES; s++ ) {
+      char name[TIMER_TRACE_NAME_SIZE + 1];
+
+      memcpy( name, &image[8 + s * TIMER_TRACE_NAME_SIZE],
+              TIMER_TRACE_NAME_SIZE );
+      name[TIMER_TRACE_NAME_SIZE] = '\0';
+      if( strcmp( name, "beat" ) == 0 ) {
+         beat_src = s;
+      } else if( strcmp( name, "frame" ) == 0 ) {
+         frame_src = s;
+      }
+   }
+
+   // Split the trace into lateness per source and runs of the beat.
+   for( uint16_t i = 0; i < count; i++ ) {
+      const uint8_t* rec = &image[TIMER_TRACE_HEADER_SIZE
+                                  + i * TIMER_TRACE_RECORD_SIZE];
+      uint8_t kind = rec[2];
+      int16_t late = (int8_t) rec[3];
+
+      t += rec[0] | ( rec[1] << 8 );
+
+      // A stall: the whole lateness is in the next record.
+      if(    late == TIMER_TRACE_LATE_ESCAPE
+          && i + 1 < count
+          && rec[TIMER_TRACE_RECORD_SIZE + 2] == TIMER_TRACE_LATE_EXT ) {
+         const uint8_t* ext = rec + TIMER_TRACE_RECORD_SIZE;
+
+         late = (int16_t) ( ext[0] | ( ext[1] << 8 ) );
+         i++;
+      }
+
+      if( kind == beat_src ) {
+         beat_late[num_beat_late++] = late;
+      } else if( kind == frame_src ) {
+         frame_late[num_frame_late++] = late;
+      } else if( kind == ( TIMER_TRACE_BUTTON_DOWN | BUTTON_SELECT ) ) {
+         last_press = t;
+         pressed = true;
+      } else if( kind == TIMER_TRACE_MARK_START && num_runs < MAX_RUNS ) {
+         runs[num_runs].start = t;
+         runs[num_runs].press_ms = pressed ? (int32_t) ( t - last_press )
+                                           : -1;
+         pressed = false;
+         in_run = true;
+      } else if( kind == TIMER_TRACE_MARK_STOP && in_run ) {
+         runs[num_runs++].stop = t;
+         in_run = false;
+      }
+   }
+   if( in_run ) {
+      runs[num_runs++].stop = t;
+   }
+   // Recording started with the beat already going.
+   if( num_runs == 0 && num_beat_late > 0 ) {
+      runs[0].start = 0;
+      runs[0].stop = t;
+      runs[0].press_ms = -1;
+      num_runs = 1;
+   }
+
+   printf( "%u events over %.1f s, %d bpm, %d slots per beat\n",
+           count, t / 1000.0, tempo, slots );
+   printf( "%d beat and %d frame timer fires, %d runs of the beat\n",
+           num_beat_late, num_frame_late, num_runs );
+   for( int i = 0; i < num_runs; i++ ) {
+      if( runs[i].press_ms >= 0 ) {
+         printf( "run %d: select down to start %ld ms\n",
+                 i + 1, (long) runs[i].press_ms );
+      }
+   }
+   if( num_beat_late == 0 ) {
+      fprintf( stderr, "no beat timers in the trace\n" );
+      return 1;
+   }
+
+   printf( "late beats: %s", beat_sched_recovery_names[recovery] );
+   if( stall_every_ms > 0 ) {
+      printf( ", %lu ms stall every %lu s",
+              (unsigned long) stall_ms,
+              (unsigned long) ( stall_every_ms / 1000 ) );
+   }
+   printf( "\n" );
+
+   printf( "\n%-10s %6s %6s %5s %6s %7s %9s %6s %7s\n",
+           "policy", "beats", "mean", "p99", "drift", "jitter",
+           "wakeups/s", "missed", "dropped" );
+   printf( "%-10s %6s %6s %5s %6s %7s %9s %6s %7s\n",
+           "", "", "|err|", "|err|", "ms", "ms", "", "", "" );
+
+   for( int p = 0; p < BEAT_SCHED_NUM_POLICIES; p++ ) {
+      late_stream beats = { beat_late, num_beat_late, 0 };
+      late_stream frames = { frame_late, num_frame_late, 0 };
+      result r;
+
+      memset( &r, 0, sizeof(r) );
+      latency_hist_reset( &r.error );
+      for( int i = 0; i < num_runs; i++ ) {
+         replay_run( &runs[i], p, tempo, slots, num_frame_late > 0,
+                     &beats, &frames, &r );
+      }
+
+      printf( "%-10s %6lu %6.1f %5u %6ld %7.2f %9.1f %6lu %7lu\n",
+              beat_sched_policy_names[p],
+              (unsigned long) r.beats,
+              r.beats ? r.error_sum / r.beats : 0.0,
+              latency_hist_percentile( &r.error, 99 ),
+              (long) r.drift,
+              r.intervals
+                 ? sqrt( r.interval_sq / r.intervals
+                         - ( r.interval_sum / r.intervals )
+                           * ( r.interval_sum / r.intervals ) )
+                 : 0.0,
+              r.ms ? r.wakeups * 1000.0 / r.ms : 0.0,
+              (unsigned long) r.misses,
+              (unsigned long) r.dropped );
+   }
+   return 0;
+}